@@ -0,0 +1,329 @@
+/*
+ * bench.cpp : Exostra Window Manager (https://github.com/aremmell/exostra)
+ *
+ * Copyright: © 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+ * Version:   0.0.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Host-side benchmarks for the compositor. Each scene is replayed against a fresh
+ * WindowManager driving the headless backend (EWM_ADAFRUIT_HEADLESS), which keeps
+ * the display in memory and counts what a real one would have been sent.
+ *
+ * Build from the root of the repository, with a checkout of Adafruit GFX
+ * (https://github.com/adafruit/Adafruit-GFX-Library) in $GFX:
+ *
+ *   g++ -std=gnu++17 -O2 -DEWM_GFX_ADAFRUIT -DEWM_ADAFRUIT_HEADLESS -DEWM_LOG_LEVEL=0 \
+ *     -Ibench/host -Iinclude -I$GFX bench/bench.cpp $GFX/Adafruit_GFX.cpp -o bench/bench
+ *
+ * Usage: bench/bench [frames] [scene]
+ *
+ * For every scene, reports render() time per frame, the number of pixels flushed to
+ * the display (and bus transactions/address windows used to do it), and two ratios:
+ *
+ *   overdraw: pixels flushed per display pixel whose value actually changed.
+ *   compose:  pixels drawn into off-screen buffers per pixel flushed.
+ */
+#include <Adafruit_GFX.h>
+#include <Fonts/FreeSans12pt7b.h>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include "exostra.h"
+
+using namespace exostra;
+
+namespace
+{
+    constexpr Extent DisplayWidth  = 480;
+    constexpr Extent DisplayHeight = 320;
+
+    class Panel : public Window
+    {
+    public:
+        using Window::Window;
+    };
+
+    // Same sequence on every platform, unlike rand().
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : _state(seed) { }
+
+        uint32_t operator()(uint32_t bound)
+        {
+            _state ^= _state << 13;
+            _state ^= _state >> 17;
+            _state ^= _state << 5;
+            return _state % bound;
+        }
+
+    private:
+        uint32_t _state;
+    };
+
+    struct Context
+    {
+        std::shared_ptr<HeadlessDisplay> display;
+        WindowManagerPtr wm;
+        Random random { 0x2545f491U };
+        WindowID nextID = 1;
+    };
+
+    using StepFn  = std::function<void(Context&, uint32_t)>;
+    using SceneFn = StepFn (*)(Context&);
+
+    std::shared_ptr<Panel> createPanel(Context& bc, Coord x, Coord y, Extent width,
+        Extent height, Style extraStyle = Style::None)
+    {
+        return bc.wm->createWindow<Panel>(nullptr, bc.nextID++,
+            Style::Visible | Style::TopLevel | extraStyle, x, y, width, height);
+    }
+
+    // A grid of labels, check boxes and buttons, a handful of which change each frame.
+    StepFn widgetsScene(Context& bc)
+    {
+        constexpr Extent Columns = 6;
+        constexpr Extent Rows    = 8;
+        auto panel = createPanel(bc, 0, 0, DisplayWidth, DisplayHeight);
+        const Extent cellWidth  = DisplayWidth / Columns;
+        const Extent cellHeight = DisplayHeight / Rows;
+        std::vector<std::shared_ptr<Label>> labels;
+        std::vector<std::shared_ptr<CheckBox>> checks;
+        for (Extent row = 0; row < Rows; row++) {
+            for (Extent col = 0; col < Columns; col++) {
+                const Coord x = col * cellWidth + 4;
+                const Coord y = row * cellHeight + 4;
+                switch ((row + col) % 3) {
+                    case 0:
+                        labels.push_back(bc.wm->createWindow<Label>(panel, bc.nextID++,
+                            Style::Label | Style::Child | Style::Visible, x, y,
+                            cellWidth - 8, cellHeight - 8, "Label"));
+                    break;
+                    case 1:
+                        checks.push_back(bc.wm->createWindow<CheckBox>(panel, bc.nextID++,
+                            Style::CheckBox | Style::Child | Style::Visible, x, y,
+                            cellWidth - 8, cellHeight - 8, "Check"));
+                    break;
+                    default:
+                        bc.wm->createWindow<Button>(panel, bc.nextID++,
+                            Style::Button | Style::Child | Style::Visible, x, y,
+                            cellWidth - 8, cellHeight - 8, "Tap");
+                    break;
+                }
+            }
+        }
+        return [=](Context& bc, uint32_t frame)
+        {
+            for (int i = 0; i < 4; i++) {
+                labels[bc.random(labels.size())]->setText(std::to_string(frame * 4 + i));
+            }
+            for (int i = 0; i < 2; i++) {
+                auto& check = checks[bc.random(checks.size())];
+                check->setChecked(!check->isChecked());
+            }
+        };
+    }
+
+    // Cascading top-level windows and prompts, brought to the front (or hidden and
+    // shown again) in turn.
+    StepFn promptsScene(Context& bc)
+    {
+        std::vector<WindowPtr> windows;
+        windows.push_back(createPanel(bc, 0, 0, DisplayWidth, DisplayHeight));
+        for (Coord i = 0; i < 4; i++) {
+            auto panel = createPanel(bc, 20 + i * 60, 20 + i * 40, 220, 160);
+            for (Coord j = 0; j < 3; j++) {
+                bc.wm->createWindow<Label>(panel, bc.nextID++,
+                    Style::Label | Style::Child | Style::Visible, panel->getRect().left + 10,
+                    panel->getRect().top + 10 + j * 45, 200, 40, "Overlapped");
+            }
+            windows.push_back(panel);
+        }
+        for (int i = 0; i < 2; i++) {
+            const auto prompt = bc.wm->createPrompt<Prompt>(nullptr, bc.nextID++,
+                Style::Prompt | Style::Visible, "Are you sure you want to do that?",
+                {{100, "Yes"}, {101, "No"}}, [](WindowID) { });
+            windows.push_back(prompt);
+        }
+        return [=](Context& bc, uint32_t frame)
+        {
+            auto& win = windows[1U + bc.random(windows.size() - 1U)];
+            if (frame % 4U == 3U) {
+                win->hide();
+            } else {
+                win->show();
+            }
+        };
+    }
+
+    // Determinate and indeterminate progress bars, all advancing every frame.
+    StepFn progressScene(Context& bc)
+    {
+        auto panel = createPanel(bc, 0, 0, DisplayWidth, DisplayHeight);
+        std::vector<std::shared_ptr<ProgressBar>> bars;
+        for (Coord i = 0; i < 8; i++) {
+            bars.push_back(bc.wm->createProgressBar<ProgressBar>(panel, bc.nextID++,
+                Style::Progress | Style::Child | Style::Visible, 20, 20 + i * 36,
+                DisplayWidth - 40, 24,
+                i % 2 == 0 ? ProgressStyle::Normal : ProgressStyle::Indeterminate));
+        }
+        return [=](Context&, uint32_t frame)
+        {
+            for (size_t i = 0; i < bars.size(); i++) {
+                bars[i]->setProgressValue(static_cast<float>((frame + i * 7U) % 101U));
+            }
+        };
+    }
+
+    // Bursts of taps at random points over a screenful of buttons and check boxes.
+    StepFn tapsScene(Context& bc)
+    {
+        auto config = bc.wm->getConfig();
+        config.minHitTestIntervalMsec = 0U;
+        bc.wm->setConfig(config);
+        auto panel = createPanel(bc, 0, 0, DisplayWidth, DisplayHeight);
+        for (Coord y = 8; y + 40 <= DisplayHeight; y += 48) {
+            for (Coord x = 8; x + 100 <= DisplayWidth; x += 116) {
+                if (((x + y) / 8) % 2 == 0) {
+                    bc.wm->createWindow<Button>(panel, bc.nextID++,
+                        Style::Button | Style::Child | Style::Visible, x, y, 100, 40, "Tap");
+                } else {
+                    bc.wm->createWindow<CheckBox>(panel, bc.nextID++,
+                        Style::CheckBox | Style::Child | Style::Visible, x, y, 100, 40, "Check");
+                }
+            }
+        }
+        return [](Context& bc, uint32_t)
+        {
+            for (int i = 0; i < 8; i++) {
+                bc.wm->hitTest(bc.random(DisplayWidth), bc.random(DisplayHeight));
+            }
+        };
+    }
+
+    struct Scene
+    {
+        const char* name;
+        SceneFn build;
+    };
+
+    const Scene Scenes[] = {
+        { "widgets",  widgetsScene  },
+        { "prompts",  promptsScene  },
+        { "progress", progressScene },
+        { "taps",     tapsScene     }
+    };
+
+    double ratio(uint64_t numerator, uint64_t denominator)
+    {
+        return denominator > 0U ? static_cast<double>(numerator) / denominator : 0.0;
+    }
+
+    bool runScene(const Scene& scene, uint32_t frames)
+    {
+        Context bc;
+        bc.display = std::make_shared<HeadlessDisplay>(DisplayWidth, DisplayHeight);
+        bc.wm      = createWindowManager(bc.display, std::make_shared<DefaultTheme>(),
+            &FreeSans12pt7b);
+        // Every call to render() is a frame here; nothing is paced.
+        auto config = bc.wm->getConfig();
+        config.maxFramesPerSec = 0U;
+        bc.wm->setConfig(config);
+        if (!bc.wm->begin(0, 0U)) {
+            fprintf(stderr, "%s: WindowManager::begin() failed\n", scene.name);
+            return false;
+        }
+        const auto step = scene.build(bc);
+        // The first frame paints everything; only what comes after is measured.
+        bc.wm->render();
+        bc.display->resetCounters();
+        HeadlessCanvas::resetTotalPixelsDrawn();
+
+        const size_t displayPixels = static_cast<size_t>(DisplayWidth) * DisplayHeight;
+        std::vector<uint16_t> previous(bc.display->getBuffer(),
+            bc.display->getBuffer() + displayPixels);
+        std::vector<double> times;
+        times.reserve(frames);
+        uint64_t changed = 0U;
+        for (uint32_t frame = 0U; frame < frames; frame++) {
+            step(bc, frame);
+            const auto begin = std::chrono::steady_clock::now();
+            bc.wm->render();
+            times.push_back(std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - begin).count());
+            const auto current = bc.display->getBuffer();
+            for (size_t i = 0U; i < displayPixels; i++) {
+                if (current[i] != previous[i]) {
+                    previous[i] = current[i];
+                    changed++;
+                }
+            }
+        }
+        bc.wm->tearDown();
+
+        std::sort(times.begin(), times.end());
+        double total = 0.0;
+        for (const auto time : times) {
+            total += time;
+        }
+        auto percentile = [&](size_t pct)
+        {
+            return times.empty() ? 0.0 : times[min(times.size() - 1U, (pct * times.size()) / 100U)];
+        };
+        const uint64_t flushed  = bc.display->getPixelsWritten();
+        const uint64_t composed = HeadlessCanvas::getTotalPixelsDrawn() -
+            bc.display->getPixelsDrawn();
+        printf("%-9s %7u %9.1f %9.1f %9.1f %9.1f %11llu %11llu %9.2f %9.2f %8u %8u\n",
+            scene.name, frames, times.empty() ? 0.0 : total / times.size(), percentile(50U),
+            percentile(99U), times.empty() ? 0.0 : times.back(),
+            static_cast<unsigned long long>(flushed), static_cast<unsigned long long>(changed),
+            ratio(flushed, changed), ratio(composed, flushed), bc.display->getAddrWindows(),
+            bc.display->getTransactions());
+        return true;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const uint32_t frames = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 500U;
+    const char* only      = argc > 2 ? argv[2] : nullptr;
+    printf("%-9s %7s %9s %9s %9s %9s %11s %11s %9s %9s %8s %8s\n", "scene", "frames",
+        "mean(us)", "p50(us)", "p99(us)", "max(us)", "flushed", "changed", "overdraw",
+        "compose", "windows", "xacts");
+    bool found = false;
+    for (const auto& scene : Scenes) {
+        if (only != nullptr && strcmp(only, scene.name) != 0) {
+            continue;
+        }
+        found = true;
+        if (!runScene(scene, frames)) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (!found) {
+        fprintf(stderr, "no such scene: %s\n", only);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
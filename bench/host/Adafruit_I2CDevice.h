@@ -0,0 +1,9 @@
+/*
+ * Adafruit_I2CDevice.h : Exostra Window Manager (https://github.com/aremmell/exostra)
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+ *
+ * Empty stand-in for the Adafruit BusIO header included by Adafruit_GFX.h; the
+ * headless backend never touches a bus (see Arduino.h).
+ */
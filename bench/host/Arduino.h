@@ -0,0 +1,75 @@
+/*
+ * Arduino.h : Exostra Window Manager (https://github.com/aremmell/exostra)
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+ *
+ * Just enough of the Arduino core to build Adafruit GFX and exostra on a desktop
+ * (for bench/bench.cpp). Not a general-purpose replacement.
+ */
+#ifndef _EWM_HOST_ARDUINO_H_INCLUDED
+# define _EWM_HOST_ARDUINO_H_INCLUDED
+
+# include <algorithm>
+# include <chrono>
+# include <cmath>
+# include <cstdint>
+# include <cstdio>
+# include <cstdlib>
+# include <cstring>
+# include <string>
+# include <thread>
+
+# if !defined(ARDUINO)
+#  define ARDUINO 10819
+# endif
+
+# define PROGMEM
+
+using std::min;
+using std::max;
+using std::abs;
+
+using boolean = bool;
+using byte    = uint8_t;
+
+inline unsigned long micros()
+{
+    using namespace std::chrono;
+    static const auto epoch = steady_clock::now();
+    return static_cast<unsigned long>(
+        duration_cast<microseconds>(steady_clock::now() - epoch).count()
+    );
+}
+
+inline unsigned long millis()
+{
+    return micros() / 1000UL;
+}
+
+inline void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void yield() { }
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+class __FlashStringHelper;
+# define F(str) (reinterpret_cast<const __FlashStringHelper*>(str))
+
+class String : public std::string
+{
+public:
+    using std::string::string;
+    String() = default;
+    String(const std::string& str) : std::string(str) { }
+};
+
+# include "Print.h"
+
+#endif // !_EWM_HOST_ARDUINO_H_INCLUDED
@@ -0,0 +1,44 @@
+/*
+ * Print.h : Exostra Window Manager (https://github.com/aremmell/exostra)
+ *
+ * SPDX-License-Identifier: MIT
+ * Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+ *
+ * Minimal stand-in for the Arduino core's Print class (see Arduino.h).
+ */
+#ifndef _EWM_HOST_PRINT_H_INCLUDED
+# define _EWM_HOST_PRINT_H_INCLUDED
+
+# include <cstddef>
+# include <cstdint>
+# include <cstring>
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t) = 0;
+
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t written = 0;
+        while (size-- > 0) {
+            written += write(*buffer++);
+        }
+        return written;
+    }
+
+    size_t write(const char* str)
+    {
+        if (str == nullptr) {
+            return 0;
+        }
+        return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+    }
+
+    size_t print(const char* str) { return write(str); }
+    size_t println(const char* str) { return print(str) + write(static_cast<uint8_t>('\n')); }
+};
+
+#endif // !_EWM_HOST_PRINT_H_INCLUDED
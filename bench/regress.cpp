@@ -0,0 +1,233 @@
+/*
+ * regress.cpp : Exostra Window Manager (https://github.com/aremmell/exostra)
+ *
+ * Copyright: © 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+ * Version:   0.0.1
+ * License:   The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the “Software”), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Host-side regression checks for the compositor, on the headless backend (see
+ * bench.cpp). Each case drives a WindowManager into a state which once went wrong,
+ * and compares what ended up on the display with the same windows painted from
+ * scratch. (A failed assertion spins forever, so a hang is a failure, too.)
+ *
+ * Build from the root of the repository, as for bench.cpp:
+ *
+ *   g++ -std=gnu++17 -O2 -DEWM_GFX_ADAFRUIT -DEWM_ADAFRUIT_HEADLESS -DEWM_LOG_LEVEL=0 \
+ *     -Ibench/host -Iinclude -I$GFX bench/regress.cpp $GFX/Adafruit_GFX.cpp -o bench/regress
+ *
+ * Usage: bench/regress (exits non-zero if any case fails)
+ */
+#include <Adafruit_GFX.h>
+#include <cstdio>
+#include <vector>
+#include "exostra.h"
+
+using namespace exostra;
+
+namespace
+{
+    constexpr Extent DisplayWidth  = 480;
+    constexpr Extent DisplayHeight = 320;
+
+    struct Context
+    {
+        std::shared_ptr<HeadlessDisplay> display;
+        WindowManagerPtr wm;
+    };
+
+    bool createContext(Context& rc)
+    {
+        rc.display = std::make_shared<HeadlessDisplay>(DisplayWidth, DisplayHeight);
+        rc.wm      = createWindowManager(rc.display, std::make_shared<DefaultTheme>(), nullptr);
+        auto config = rc.wm->getConfig();
+        config.maxFramesPerSec = 0U;
+        rc.wm->setConfig(config);
+        return rc.wm->begin(0, 0U);
+    }
+
+    // A label which remembers whether it has been pressed.
+    class PressedLabel : public Label
+    {
+    public:
+        using Label::Label;
+
+        bool onPressed([[maybe_unused]] Coord x, [[maybe_unused]] Coord y) override
+        {
+            pressed = true;
+            return true;
+        }
+
+        bool pressed = false;
+    };
+
+    // A full-screen window, and above it a smaller one with a child.
+    std::shared_ptr<Window> createWindows(Context& rc, Coord x, Coord y,
+        std::shared_ptr<PressedLabel>* child = nullptr)
+    {
+        rc.wm->createWindow<Window>(nullptr, 1, Style::Visible | Style::TopLevel, 0, 0,
+            DisplayWidth, DisplayHeight);
+        auto top = rc.wm->createWindow<Window>(nullptr, 2,
+            Style::Visible | Style::TopLevel | Style::Frame, x, y, 200, 120);
+        auto label = rc.wm->createWindow<PressedLabel>(top, 3,
+            Style::Visible | Style::Child | Style::Label, x + 10, y + 10, 120, 24, "label");
+        if (child) {
+            *child = label;
+        }
+        return top;
+    }
+
+    bool sameDisplay(const Context& a, const Context& b)
+    {
+        const size_t pixels = static_cast<size_t>(DisplayWidth) * DisplayHeight;
+        return memcmp(a.display->getBuffer(), b.display->getBuffer(),
+            pixels * sizeof(uint16_t)) == 0;
+    }
+
+    // A top-level window moved more than once between frames mustn't be left with
+    // dirty rects from where it was before.
+    bool movedTwiceBeforeRender()
+    {
+        Context moved;
+        Context expected;
+        if (!createContext(moved) || !createContext(expected)) {
+            return false;
+        }
+        auto top = createWindows(moved, 40, 40);
+        moved.wm->render();
+        top->moveBy(5, 5);
+        top->moveBy(5, 5);
+        moved.wm->render();
+        createWindows(expected, 50, 50);
+        expected.wm->render();
+        const auto same = sameDisplay(moved, expected);
+        moved.wm->tearDown();
+        expected.wm->tearDown();
+        return same;
+    }
+
+    // A child scrolled entirely out of its parent mustn't be hit by a press at the
+    // origin (which Rect(), its intersection with the parent, contains).
+    bool pressAtOriginMissesHiddenChild()
+    {
+        Context rc;
+        if (!createContext(rc)) {
+            return false;
+        }
+        std::shared_ptr<PressedLabel> child;
+        auto top = createWindows(rc, 40, 40, &child);
+        rc.wm->render();
+        top->scrollBy(60, 210, top->getRect());
+        rc.wm->render();
+        rc.wm->postTouch(0, 0, true);
+        rc.wm->render();
+        rc.wm->postTouch(0, 0, false);
+        rc.wm->render();
+        const auto missed = !child->pressed;
+        rc.wm->tearDown();
+        return missed;
+    }
+
+    // Changes batched by an update must still be drawn if the top-level window is
+    // moved (or its contents scrolled) before the next frame.
+    bool batchedThenMoved(bool scroll)
+    {
+        Context moved;
+        Context expected;
+        if (!createContext(moved) || !createContext(expected)) {
+            return false;
+        }
+        std::shared_ptr<PressedLabel> child;
+        auto top = createWindows(moved, 40, 40, &child);
+        moved.wm->render();
+        {
+            ScopedUpdate update(moved.wm);
+            child->setBgColor(colorFrom565(0xf800));
+        }
+        std::shared_ptr<PressedLabel> expectedChild;
+        auto expectedTop = createWindows(expected, 40, 40, &expectedChild);
+        expectedChild->setBgColor(colorFrom565(0xf800));
+        expected.wm->render();
+        if (scroll) {
+            top->scrollBy(10, 0, top->getRect());
+            expectedTop->scrollBy(10, 0, expectedTop->getRect());
+        } else {
+            top->moveBy(10, 0);
+            expectedTop->moveBy(10, 0);
+        }
+        moved.wm->render();
+        expected.wm->render();
+        const auto same = sameDisplay(moved, expected);
+        moved.wm->tearDown();
+        expected.wm->tearDown();
+        return same;
+    }
+
+    bool batchedThenMovedBy() { return batchedThenMoved(false); }
+    bool batchedThenScrolledBy() { return batchedThenMoved(true); }
+
+    // A derived theme's colors apply from the start, not only once the window manager
+    // has set the display's extents.
+    bool derivedThemeColorsApply()
+    {
+        class RedTheme : public DefaultTheme
+        {
+        protected:
+            Color resolveColor(ColorID colorID) const override
+            {
+                return colorID == ColorID::WindowBg ? colorFrom565(0xf800)
+                    : DefaultTheme::resolveColor(colorID);
+            }
+        };
+        auto red = RedTheme();
+        if (red.getColor(ColorID::WindowBg) != colorFrom565(0xf800)) {
+            return false;
+        }
+        red.setDisplayExtents(DisplayWidth, DisplayHeight);
+        return red.getColor(ColorID::WindowBg) == colorFrom565(0xf800);
+    }
+
+    struct Case
+    {
+        const char* name;
+        bool (*run)();
+    };
+
+    const Case Cases[] = {
+        { "moved twice before render", movedTwiceBeforeRender },
+        { "press at origin misses hidden child", pressAtOriginMissesHiddenChild },
+        { "derived theme colors apply", derivedThemeColorsApply },
+        { "batched update, then moved", batchedThenMovedBy },
+        { "batched update, then scrolled", batchedThenScrolledBy }
+    };
+} // namespace
+
+int main()
+{
+    int failed = 0;
+    for (const auto& test : Cases) {
+        const bool passed = test.run();
+        printf("%-40s %s\n", test.name, passed ? "ok" : "FAILED");
+        failed += passed ? 0 : 1;
+    }
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -26,20 +26,94 @@
 #ifndef _EXOSTRA_H_INCLUDED
 # define _EXOSTRA_H_INCLUDED
 
+# include <algorithm>
+# include <cstddef>
 # include <cstdint>
+# include <cstdlib>
+# include <cstring>
 # include <functional>
 # include <type_traits>
 # include <string>
+# include <string_view>
 # include <memory>
 # include <array>
-# include <queue>
+# include <vector>
+# include <deque>
 # include <mutex>
+# include <atomic>
+# include <tuple>
+# include <utility>
+
+// Color mode of graphics contexts: EWM_COLOR_565 (16-bit RGB), or EWM_COLOR_888 (24-bit
+// RGB, converted to the display's RGB565 a dirty rect at a time as it's flushed; for
+// Adafruit_SPITFT, RA8875 and headless displays only).
+# if !defined(EWM_COLOR_565) && !defined(EWM_COLOR_888)
+#  define EWM_COLOR_565
+# endif
+
+// Disables mutex locks required in multi-threaded environments. Define EWM_MUTEXES
+// (e.g. -DEWM_MUTEXES) to keep them.
+# if !defined(EWM_MUTEXES) && !defined(EWM_NOMUTEXES)
+#  define EWM_NOMUTEXES
+# endif
+
+// Guards every window hierarchy with one (recursive) mutex which render() and
+// hitTest() take once per pass, rather than each container locking its own upon
+// every call. Code touching windows from other threads must then hold
+// getTreeMutex() itself. Has no effect unless EWM_MUTEXES is defined.
+//# define EWM_SINGLE_TREE_LOCK
+
+// Runs render() on a FreeRTOS task of its own (see WindowManager::startRenderTask()),
+// pinned to EWM_RENDER_TASK_CORE, which sleeps whenever there is nothing to draw.
+// Touch input is then handed to it with WindowManager::postInput(), which never
+// blocks, so reading the touch controller no longer waits on the frame in progress.
+// Any other code touching windows must hold getTreeMutex() while doing so; requires
+// EWM_SINGLE_TREE_LOCK and EWM_MUTEXES.
+//# define EWM_RENDER_TASK
+
+// Core, priority and stack size (in bytes) of the render task. The Arduino loop()
+// task lives on core 1, so by default the render task takes the other one.
+# if !defined(EWM_RENDER_TASK_CORE)
+#  define EWM_RENDER_TASK_CORE 0
+# endif
+# if !defined(EWM_RENDER_TASK_PRIORITY)
+#  define EWM_RENDER_TASK_PRIORITY 2
+# endif
+# if !defined(EWM_RENDER_TASK_STACK)
+#  define EWM_RENDER_TASK_STACK 8192
+# endif
+
+// Number of messages each window's queue holds (inline, without touching the heap).
+// Draw and Resize messages are coalesced with any of the same already waiting, so
+// this is rarely approached; should a queue fill up, further messages are dropped.
+# if !defined(EWM_WINDOW_QUEUE_LEN)
+#  define EWM_WINDOW_QUEUE_LEN 8
+# endif
+
+// Number of input events WindowManager::postInput() can hold until the next frame
+// picks them up; more than that are dropped. Must be a power of two.
+# if !defined(EWM_INPUT_QUEUE_LEN)
+#  define EWM_INPUT_QUEUE_LEN 16
+# endif
+
+// Number of touch points (fingers) tracked at once by WindowManager::postTouch(); each
+// has a gesture state of its own.
+# if !defined(EWM_MAX_POINTERS)
+#  define EWM_MAX_POINTERS 2
+# endif
 
-// TODO: remove me
-# define EWM_COLOR_565
+// How often (in milliseconds) a TouchDriver reads its controller when there is nothing
+// telling it to: always, if the controller's interrupt line isn't connected, or else
+// only while a touch is in progress (to notice it end, should the line stay quiet).
+# if !defined(EWM_TOUCH_POLL_MSEC)
+#  define EWM_TOUCH_POLL_MSEC 20
+# endif
 
-// Disables mutex locks required in multi-threaded environments.
-# define EWM_NOMUTEXES
+// Number of timers and animations (combined) that WindowManager can run at once,
+// held inline; setTimer() and animate() fail while that many are in use.
+# if !defined(EWM_MAX_TIMERS)
+#  define EWM_MAX_TIMERS 8
+# endif
 
 // Available logging levels.
 # define EWM_LOG_LEVEL_NONE    0
@@ -51,7 +125,126 @@
 
 // Enabled logging level (setting to any level except EWM_LOG_LEVEL_NONE increases
 // the resulting binary size substantially!).
-# define EWM_LOG_LEVEL EWM_LOG_LEVEL_VERBOSE //EWM_LOG_LEVEL_NONE
+# if !defined(EWM_LOG_LEVEL)
+#  define EWM_LOG_LEVEL EWM_LOG_LEVEL_VERBOSE //EWM_LOG_LEVEL_NONE
+# endif
+
+// Composes all top-level windows (in Z-order) into a single display-sized off-screen
+// buffer, rather than pairing each top-level window with its own. Uses far less
+// memory (hidden windows consume no pixel memory at all), at the cost of redrawing
+// windows whose pixels were overwritten by those beneath them.
+//# define EWM_SHARED_FRAMEBUFFER
+
+// Maximum number of rects held by a Region (e.g. a window's damaged area). Regions
+// needing more than this are approximated, which results in some overdraw.
+# if !defined(EWM_REGION_MAX_RECTS)
+#  define EWM_REGION_MAX_RECTS 16
+# endif
+
+// Distance (in pixels) within which a window's dirty rects are merged into one
+// another. Merging rects that nearly touch trades a sliver of overdraw for fewer
+// (and larger) transfers to the display.
+# if !defined(EWM_DIRTY_RECT_SLOP)
+#  define EWM_DIRTY_RECT_SLOP 8
+# endif
+
+// Number of text layouts (line breaks and glyph positions) remembered by DefaultTheme,
+// so that redrawing text which hasn't changed skips measuring it all over again.
+// 0 disables the cache.
+# if !defined(EWM_TEXT_LAYOUT_CACHE)
+#  define EWM_TEXT_LAYOUT_CACHE 16
+# endif
+
+// Number of characters of a window's text kept within the window itself; longer text
+// goes on the heap (see InlineString, and Window::reserveText()).
+# if !defined(EWM_WINDOW_TEXT_INLINE)
+#  define EWM_WINDOW_TEXT_INLINE 23
+# endif
+
+// Rasterizes the glyphs of custom (GFXfont) fonts into runs of horizontal pixels the
+// first time each font is drawn, so that text is filled a row span at a time rather
+// than a pixel at a time. Costs a few kilobytes of RAM per font in use.
+//# define EWM_GLYPH_ATLAS
+
+// Run-length encodes the gfx contexts of top-level windows which are hidden, or
+// entirely covered by other windows, once nothing has drawn into them for
+// EWM_COMPRESS_IDLE_MSEC, and releases their pixel buffers (on ESP32, the encoded runs
+// are kept in PSRAM where there is any). A context is decoded again the next time it's
+// needed, such as when the window is shown. Mostly flat fills encode to a small
+// fraction of their size; a context which wouldn't shrink by at least half is left
+// alone. Unavailable with EWM_SHARED_FRAMEBUFFER.
+//# define EWM_COMPRESS_IDLE_CONTEXTS
+
+// See EWM_COMPRESS_IDLE_CONTEXTS.
+# if !defined(EWM_COMPRESS_IDLE_MSEC)
+#  define EWM_COMPRESS_IDLE_MSEC 2000
+# endif
+
+// Size (in pixels) of each square cell of the grid used to look up which windows
+// occupy a given area of the display. Smaller cells yield fewer false candidates per
+// query, at the cost of memory (one bit per window, per cell).
+# if !defined(EWM_SPATIAL_CELL_PX)
+#  define EWM_SPATIAL_CELL_PX 32
+# endif
+
+// Size (in pixels) of each of the two DMA-capable bounce buffers used to flush dirty
+// rects to Adafruit_SPITFT displays. Larger buffers mean fewer (but longer) bus
+// transfers; 0 disables the flush pipeline and reverts to blocking line-by-line writes.
+# if !defined(EWM_FLUSH_BUFFER_PX)
+#  define EWM_FLUSH_BUFFER_PX 4096
+# endif
+
+// Minimum number of same-colored pixels in a dirty rect (a run within a row, or a
+// band of whole rows) for which an RA8875 is told to fill a rect, rather than being
+// sent the pixels themselves. Below this, the registers written to set up the fill
+// cost more than they save (EWM_ADAFRUIT_RA8875 only).
+# if !defined(EWM_RA8875_FILL_RUN_PX)
+#  define EWM_RA8875_FILL_RUN_PX 48
+# endif
+
+// Size (in bytes) of a line of the data cache which sits in front of PSRAM; the ranges
+// of an RGB panel's framebuffer that are written back after a flush are aligned to
+// it (EWM_GFX_ARDUINO only).
+# if !defined(EWM_CACHE_LINE_BYTES)
+#  if defined(CONFIG_ESP32S3_DATA_CACHE_LINE_SIZE)
+#   define EWM_CACHE_LINE_BYTES CONFIG_ESP32S3_DATA_CACHE_LINE_SIZE
+#  else
+#   define EWM_CACHE_LINE_BYTES 32
+#  endif
+# endif
+
+// Number of frames whose statistics (compose/flush time, pixels pushed, etc.) are
+// retained by WindowManager::getRenderStats(). Percentiles are computed over this many
+// of the most recent frames.
+# if !defined(EWM_RENDER_STATS_FRAMES)
+#  define EWM_RENDER_STATS_FRAMES 64
+# endif
+
+// Disables the collection of per-frame render statistics (and the two calls to
+// micros() per flushed rect that come with it).
+//# define EWM_NORENDERSTATS
+
+// Enables the damage debugging aids: an overlay which shows what each frame flushed to
+// the display (see WindowManager::setDamageOverlay()), and a compact binary record of
+// each frame's flushed rects and timings (see WindowManager::setDamageLogCallback()),
+// e.g. for streaming over serial. Compiles to nothing unless defined.
+//# define EWM_DAMAGE_DEBUG
+
+// How long (in milliseconds) the damage overlay stays on screen before the pixels it
+// covers are flushed again.
+# if !defined(EWM_DAMAGE_OVERLAY_MSEC)
+#  define EWM_DAMAGE_OVERLAY_MSEC 250
+# endif
+
+// Maximum number of flushed rects recorded per frame, for the damage log and overlay
+// outlines. Any beyond are still counted.
+# if !defined(EWM_DAMAGE_LOG_RECTS)
+#  define EWM_DAMAGE_LOG_RECTS 32
+# endif
+
+// Disables exostra's own raster kernels (see Raster), which fill rects and rounded
+// rects directly in off-screen buffers, in favor of the graphics library's routines.
+//# define EWM_NORASTER
 
 // Enables runtime assertions. Upon a failed assertion, prints the expression that
 // evaluated to false, as well as the backtrace leading up to the failed assertion
@@ -61,6 +254,7 @@
 
 # if defined(ESP32) || defined(ESP8266)
 #  include <esp_debug_helpers.h>
+#  include <esp_heap_caps.h>
 #  define EWM_BACKTRACE_FRAMES 5
 #  define print_backtrace() \
     ets_install_putc1([](char c) \
@@ -69,7 +263,23 @@
     }); \
     esp_backtrace_print(EWM_BACKTRACE_FRAMES)
 # else
-#  define print_backtrace
+#  define print_backtrace()
+# endif
+
+# if defined(EWM_MUTEXES) && defined(EWM_NOMUTEXES)
+#  error "EWM_MUTEXES and EWM_NOMUTEXES are mutually exclusive"
+# endif
+
+# if defined(EWM_RENDER_TASK)
+#  if defined(EWM_NOMUTEXES) || !defined(EWM_SINGLE_TREE_LOCK)
+#   error "EWM_RENDER_TASK requires EWM_SINGLE_TREE_LOCK and EWM_MUTEXES"
+#  endif
+#  include <freertos/FreeRTOS.h>
+#  include <freertos/task.h>
+# endif
+
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS) && defined(EWM_SHARED_FRAMEBUFFER)
+#  error "EWM_COMPRESS_IDLE_CONTEXTS is incompatible with EWM_SHARED_FRAMEBUFFER"
 # endif
 
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
@@ -143,6 +353,187 @@
 #    error "Adafruit_RA8875.h is a required header when EWM_ADAFRUIT_RA8875 is defined"
 #   endif
     using IGfxDisplay = Adafruit_RA8875;
+#  elif defined(EWM_ADAFRUIT_HEADLESS)
+#   if __has_include(<Adafruit_GFX.h>)
+#    include <Adafruit_GFX.h>
+#   else
+#    error "Adafruit_GFX.h is a required header when EWM_ADAFRUIT_HEADLESS is defined"
+#   endif
+namespace exostra
+{
+    /**
+     * GFXcanvas16 which counts the pixels drawn into it (clipped to its bounds), for
+     * measuring how much composing gets done off-device.
+     */
+    class HeadlessCanvas : public GFXcanvas16
+    {
+    public:
+        HeadlessCanvas(uint16_t w, uint16_t h) : GFXcanvas16(w, h) { }
+
+        void drawPixel(int16_t x, int16_t y, uint16_t color) override
+        {
+            _countDrawn(_clippedSpan(x, 1, width(), y, height()));
+            GFXcanvas16::drawPixel(x, y, color);
+        }
+
+        void fillScreen(uint16_t color) override
+        {
+            _countDrawn(static_cast<uint32_t>(width()) * height());
+            GFXcanvas16::fillScreen(color);
+        }
+
+        void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override
+        {
+            _countDrawn(_clippedSpan(x, w, width(), y, height()));
+            GFXcanvas16::drawFastHLine(x, y, w, color);
+        }
+
+        void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override
+        {
+            _countDrawn(_clippedSpan(y, h, height(), x, width()));
+            GFXcanvas16::drawFastVLine(x, y, h, color);
+        }
+
+        // For drawing done directly in the buffer (see Raster).
+        void countPixelsDrawn(uint32_t pixels) noexcept { _countDrawn(pixels); }
+
+        uint32_t getPixelsDrawn() const noexcept { return _pixelsDrawn; }
+
+        // Pixels drawn into every HeadlessCanvas (and HeadlessDisplay) since the last
+        // call to resetTotalPixelsDrawn().
+        static uint32_t getTotalPixelsDrawn() noexcept { return _totalPixelsDrawn; }
+        static void resetTotalPixelsDrawn() noexcept { _totalPixelsDrawn = 0U; }
+
+        // For other canvases (i.e., Canvas888) to count toward the total.
+        static void countTotalPixelsDrawn(uint32_t pixels) noexcept
+        {
+            _totalPixelsDrawn += pixels;
+        }
+
+        virtual void resetCounters() noexcept { _pixelsDrawn = 0U; }
+
+    private:
+        static uint32_t _clippedSpan(int16_t start, int16_t length, int16_t limit,
+            int16_t across, int16_t acrossLimit) noexcept
+        {
+            if (across < 0 || across >= acrossLimit) {
+                return 0U;
+            }
+            if (length < 0) {
+                start += length + 1;
+                length = -length;
+            }
+            const int32_t begin = std::max<int32_t>(start, 0);
+            const int32_t end   = std::min<int32_t>(start + length, limit);
+            return end > begin ? static_cast<uint32_t>(end - begin) : 0U;
+        }
+
+        void _countDrawn(uint32_t pixels) noexcept
+        {
+            _pixelsDrawn += pixels;
+            countTotalPixelsDrawn(pixels);
+        }
+
+        uint32_t _pixelsDrawn = 0U;
+        static inline uint32_t _totalPixelsDrawn = 0U;
+    };
+
+    /**
+     * Memory-backed stand-in for an Adafruit_SPITFT display, which implements the
+     * subset of its interface driven by the window manager, and counts the pixels
+     * written and bus transactions a real display would have seen. Used to run (and
+     * benchmark) the compositor on the host.
+     */
+    class HeadlessDisplay : public HeadlessCanvas
+    {
+    public:
+        HeadlessDisplay(uint16_t w, uint16_t h) : HeadlessCanvas(w, h) { }
+
+        void begin(uint32_t = 0U) { }
+
+        void startWrite() override { _transactions++; }
+        void endWrite() override { }
+
+        void setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+        {
+            _addrWindow = Window { x, y, w, h };
+            _addrPos    = 0U;
+            _addrWindows++;
+        }
+
+        // Big-endian pixels (as sent by the 24-bit flush pipeline) are swapped back as
+        // they're stored.
+        void writePixels(uint16_t* colors, uint32_t len, bool = true, bool bigEndian = false)
+        {
+            EWM_ASSERT(colors != nullptr);
+            _writes++;
+            _pixelsWritten += len;
+            const uint32_t capacity = static_cast<uint32_t>(_addrWindow.w) * _addrWindow.h;
+            EWM_ASSERT(_addrPos + len <= capacity);
+            len = std::min(len, capacity - std::min(_addrPos, capacity));
+            while (len > 0U) {
+                const uint16_t col = _addrPos % _addrWindow.w;
+                const uint16_t row = _addrPos / _addrWindow.w;
+                const uint32_t run = std::min(len, static_cast<uint32_t>(_addrWindow.w - col));
+                const int16_t x    = _addrWindow.x + col;
+                const int16_t y    = _addrWindow.y + row;
+                if (getRotation() == 0U && x + static_cast<int32_t>(run) <= width() && y < height()) {
+                    uint16_t* dst = getBuffer() + (y * width()) + x;
+                    if (bigEndian) {
+                        for (uint32_t i = 0U; i < run; i++) {
+                            dst[i] = static_cast<uint16_t>((colors[i] << 8) | (colors[i] >> 8));
+                        }
+                    } else {
+                        memcpy(dst, colors, run * sizeof(uint16_t));
+                    }
+                } else {
+                    for (uint32_t i = 0U; i < run; i++) {
+                        const uint16_t color = bigEndian
+                            ? static_cast<uint16_t>((colors[i] << 8) | (colors[i] >> 8)) : colors[i];
+                        GFXcanvas16::drawPixel(static_cast<int16_t>(x + i), y, color);
+                    }
+                }
+                colors   += run;
+                _addrPos += run;
+                len      -= run;
+            }
+        }
+
+        void dmaWait() { }
+        bool dmaBusy() const { return false; }
+
+        uint32_t getPixelsWritten() const noexcept { return _pixelsWritten; }
+        uint32_t getTransactions() const noexcept { return _transactions; }
+        uint32_t getAddrWindows() const noexcept { return _addrWindows; }
+        uint32_t getWrites() const noexcept { return _writes; }
+
+        void resetCounters() noexcept override
+        {
+            HeadlessCanvas::resetCounters();
+            _pixelsWritten = 0U;
+            _transactions  = 0U;
+            _addrWindows   = 0U;
+            _writes        = 0U;
+        }
+
+    private:
+        struct Window
+        {
+            uint16_t x = 0U;
+            uint16_t y = 0U;
+            uint16_t w = 0U;
+            uint16_t h = 0U;
+        };
+
+        Window _addrWindow;
+        uint32_t _addrPos       = 0U;
+        uint32_t _pixelsWritten = 0U;
+        uint32_t _transactions  = 0U;
+        uint32_t _addrWindows   = 0U;
+        uint32_t _writes        = 0U;
+    };
+} // namespace exostra
+    using IGfxDisplay = exostra::HeadlessDisplay;
 #  else
 #   if __has_include(<Adafruit_SPITFT.h>)
 #    include <Adafruit_SPITFT.h>
@@ -151,7 +542,11 @@
 #   endif
     using IGfxDisplay = Adafruit_SPITFT;
 #  endif
+#  if defined(EWM_ADAFRUIT_HEADLESS)
+    using IGfxContext16 = exostra::HeadlessCanvas;
+#  else
     using IGfxContext16 = GFXcanvas16;
+#  endif
 #  if defined(__AVR__)
 #   include <avr/pgmspace.h>
 #  elif defined(ESP32) || defined(ESP8266)
@@ -184,6 +579,9 @@
 #  endif
 #  if defined(ATTINY_CORE)
 #   error "required GFXfont implementation unavailable due to ATTINY_CORE"
+#  endif
+#  if defined(CONFIG_IDF_TARGET_ESP32S3)
+#   include <esp32s3/rom/cache.h>
 #  endif
     using IGfxDisplay   = Arduino_RGB_Display;
     using IGfxContext16 = Arduino_Canvas;
@@ -200,6 +598,9 @@ namespace exostra
     /** Represents an invalid window identifier. */
     EWM_CONST(WindowID, WID_INVALID, 0);
 
+    /** Timer (or animation) identifier; unique per window. */
+    using TimerID = uint8_t;
+
     /** Window message parameter type. */
     using MsgParam = uint32_t;
 
@@ -213,10 +614,16 @@ namespace exostra
     using GfxDisplayPtr = std::shared_ptr<GfxDisplay>;
 
 # if defined(EWM_COLOR_565)
-    using Color      = uint16_t;      /**< Color type (16-bit 565 RGB). */
-    using GfxContext = IGfxContext16; /**< Graphics context (16-bit 565 RGB). */
+    class GfxCanvas;
+    using Color      = uint16_t;  /**< Color type (16-bit 565 RGB). */
+    using GfxContext = GfxCanvas; /**< Graphics context (16-bit 565 RGB). */
 # elif defined(EWM_COLOR_888)
-#  error "24-bit RGB mode is not yet implemented"
+#  if !defined(EWM_GFX_ADAFRUIT)
+#   error "24-bit RGB mode is only implemented for Adafruit_SPITFT, RA8875 and headless displays"
+#  endif
+    class GfxCanvas;
+    using Color      = uint32_t;  /**< Color type (24-bit 888 RGB, as 0x00RRGGBB). */
+    using GfxContext = GfxCanvas; /**< Graphics context (24-bit 888 RGB). */
 # else
 #  error "define EWM_COLOR_565 or EWM_COLOR_888 in order to select a color mode"
 # endif
@@ -303,6 +710,14 @@ namespace exostra
             bottom += px;
         }
 
+        void offset(Coord dx, Coord dy) noexcept
+        {
+            left   += dx;
+            top    += dy;
+            right  += dx;
+            bottom += dy;
+        }
+
         void deflate(Extent px) noexcept
         {
             EWM_ASSERT(px < width());
@@ -364,113 +779,6 @@ namespace exostra
             bottom = max(bottom, rect.bottom);
         }
 
-        std::queue<Rect> subtractRect(const Rect& other) const
-        {
-            std::queue<Rect> rects;
-            if (intersectsRect(other)) {
-                auto mergedRect = *this;
-                mergedRect.mergeRect(other);
-                const auto alignedLeft   = mergedRect.left   >= other.left;
-                const auto alignedTop    = mergedRect.top    >= other.top;
-                const auto alignedRight  = mergedRect.right  <= other.right;
-                const auto alignedBottom = mergedRect.bottom <= other.bottom;
-                if (!alignedLeft || !alignedTop || !alignedRight || !alignedBottom) {
-                    const auto topNoAlignTop       = max(mergedRect.top, top);
-                    const auto topNoAlignBottom    = min(mergedRect.bottom, other.bottom);
-                    const auto bottomNoAlignTop    = min(mergedRect.bottom, other.top);
-                    const auto bottomNoAlignBottom = min(mergedRect.bottom, bottom);
-                    const auto leftNoAlignRight    = min(mergedRect.right, other.right);
-                    const auto leftNoAlignLeft     = max(mergedRect.left, left);
-                    const auto rightNoAlignRight   = min(mergedRect.right, right);
-                    const auto rightNoAlignLeft    = max(mergedRect.left, other.left);
-                    if (alignedLeft || alignedRight) {
-                        if (alignedLeft && !alignedRight) {
-                            rects.emplace(
-                                leftNoAlignRight,
-                                max(mergedRect.top, top),
-                                rightNoAlignRight,
-                                min(mergedRect.bottom, bottom)
-                            );
-                        }
-                        if (alignedRight && !alignedLeft) {
-                            rects.emplace(
-                                leftNoAlignLeft,
-                                max(mergedRect.top, top),
-                                rightNoAlignLeft,
-                                min(mergedRect.bottom, bottom)
-                            );
-                        }
-                        if (!alignedTop && !alignedBottom) {
-                            rects.emplace(
-                                max(mergedRect.left, left),
-                                topNoAlignTop,
-                                min(mergedRect.right, right),
-                                bottomNoAlignTop
-                            );
-                            rects.emplace(
-                                max(mergedRect.left, left),
-                                topNoAlignBottom,
-                                min(mergedRect.right, right),
-                                bottomNoAlignBottom
-                            );
-                        }
-                    }
-                    if (alignedTop || alignedBottom) {
-                        if (alignedTop && !alignedBottom) {
-                            rects.emplace(
-                                max(mergedRect.left, left),
-                                topNoAlignBottom,
-                                min(mergedRect.right, right),
-                                bottomNoAlignBottom
-                            );
-                        }
-                        if (alignedBottom && !alignedTop) {
-                            rects.emplace(
-                                max(mergedRect.left, left),
-                                topNoAlignTop,
-                                min(mergedRect.right, right),
-                                bottomNoAlignTop
-                            );
-                        }
-                        if (!alignedLeft && !alignedRight) {
-                            rects.emplace(
-                                leftNoAlignRight,
-                                max(mergedRect.top, top),
-                                rightNoAlignRight,
-                                min(mergedRect.bottom, bottom)
-                            );
-                            rects.emplace(
-                                leftNoAlignLeft,
-                                max(mergedRect.top, top),
-                                rightNoAlignLeft,
-                                min(mergedRect.bottom, bottom)
-                            );
-                        }
-                    }
-                    if (!alignedLeft && !alignedTop && !alignedRight && !alignedBottom) {
-                        Rect edgeRect(
-                            min(other.left, left),
-                            min(other.top, top),
-                            max(other.left, left),
-                            max(other.bottom, bottom)
-                        );
-                        rects.push(edgeRect);
-                        edgeRect.right  = max(other.right, right);
-                        edgeRect.bottom = max(other.top, top);
-                        rects.push(edgeRect);
-                        edgeRect.left   = min(other.right, right);
-                        edgeRect.top    = min(other.top, top);
-                        edgeRect.bottom = max(other.bottom, bottom);
-                        rects.push(edgeRect);
-                        edgeRect.left = min(other.left, left);
-                        edgeRect.top  = min(other.bottom, bottom);
-                        rects.push(edgeRect);
-                    }
-                }
-            }
-            return std::move(rects);
-        }
-
         bool outsideRect(const Rect& other) const noexcept
         {
             return !other.pointWithin(left, top) &&
@@ -493,1638 +801,5568 @@ namespace exostra
         }
     };
 
-    inline Color* getGfxBuffer(const GfxContextPtr& ctx)
+    /**
+     * Conversions between pixel formats: that of graphics contexts (Color) on one side,
+     * and those of displays on the other. Spans are converted in a single pass, with
+     * any byte swapping the display calls for done along the way.
+     */
+    class PixelFormat
     {
-# if defined(EWM_GFX_ADAFRUIT)
-        return ctx->getBuffer();
-# else
-        return ctx->getFramebuffer();
-# endif
-    }
+    public:
+        static constexpr uint16_t rgb888To565(uint32_t rgb) noexcept
+        {
+            return static_cast<uint16_t>(((rgb >> 8) & 0xf800U) | ((rgb >> 5) & 0x07e0U) |
+                ((rgb >> 3) & 0x001fU));
+        }
 
-    inline GFXglyph* getGlyphAtOffset(const GFXfont* font, uint8_t off)
+        // The low bits of each channel are filled in from the high bits, so that white
+        // stays white, and converting back to RGB565 yields the same value.
+        static constexpr uint32_t rgb565To888(uint16_t rgb) noexcept
+        {
+            const uint32_t r = (rgb >> 11) & 0x1fU;
+            const uint32_t g = (rgb >> 5) & 0x3fU;
+            const uint32_t b = rgb & 0x1fU;
+            return (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) |
+                ((b << 3) | (b >> 2));
+        }
+
+        // Converts `count` 0x00RRGGBB pixels to RGB565, in big-endian byte order (as
+        // displays take it) if `swap` is true.
+        static void rgb888To565(const uint32_t* src, uint16_t* dst, size_t count,
+            bool swap) noexcept
+        {
+            if (swap) {
+                _rgb888To565<true>(src, dst, count);
+            } else {
+                _rgb888To565<false>(src, dst, count);
+            }
+        }
+
+    private:
+        // Kept to straight-line, branch-free arithmetic per pixel, so that compilers
+        // able to vectorize the loop do.
+        template<bool Swap>
+        static void _rgb888To565(const uint32_t* src, uint16_t* dst, size_t count) noexcept
+        {
+            for (size_t i = 0U; i < count; i++) {
+                const auto pixel = rgb888To565(src[i]);
+                dst[i] = Swap ? static_cast<uint16_t>((pixel << 8) | (pixel >> 8)) : pixel;
+            }
+        }
+    };
+
+    /** Converts a Color to what the graphics library draws with (RGB565). */
+    constexpr uint16_t toGfxColor(Color color) noexcept
     {
-# ifdef __AVR__
-        return &((static_cast<GFXglyph*>(pgm_read_pointer(&font->glyph)))[off]);
+# if defined(EWM_COLOR_888)
+        return PixelFormat::rgb888To565(color);
 # else
-        return font->glyph + off;
+        return color;
 # endif
     }
 
-    static void getCharBounds(uint8_t ch, uint8_t* cx, uint8_t* cy, uint8_t* xAdv,
-        uint8_t* yAdv, int8_t* xOff, int8_t* yOff, uint8_t textSize = 1,
-        const GFXfont* font = nullptr) noexcept
+    /** Converts an RGB565 value to a Color. */
+    constexpr Color colorFrom565(uint16_t rgb) noexcept
     {
-        uint8_t first = font ? pgm_read_byte(&font->first) : 0;
-        bool okCh = font ? ch >= first && ch <= pgm_read_byte(&font->last) : false;
-        auto glyph = okCh ? getGlyphAtOffset(font, ch - first) : nullptr;
-        if (cx) { *cx = textSize * (font ? (okCh ? pgm_read_byte(&glyph->width) : 0) : 6); }
-        if (cy) { *cy = textSize * (font ? (okCh ? pgm_read_byte(&glyph->height) : 0) : 8); }
-        if (xAdv) { *xAdv = textSize * (okCh ? pgm_read_byte(&glyph->xAdvance) : 6); }
-        if (yAdv) { *yAdv = okCh ? pgm_read_byte(&font->yAdvance) : textSize * 8; }
-        if (xOff) { *xOff = okCh ? pgm_read_byte(&glyph->xOffset) : 0; }
-        if (yOff) { *yOff = okCh ? pgm_read_byte(&glyph->yOffset) : 0; }
+# if defined(EWM_COLOR_888)
+        return PixelFormat::rgb565To888(rgb);
+# else
+        return rgb;
+# endif
     }
 
-    template<typename T>
-    constexpr T operator&(const T& t1, const T& t2)
+# if defined(EWM_COLOR_888)
+    /**
+     * 24-bit counterpart of GFXcanvas16, with a buffer of Color (0x00RRGGBB). exostra's
+     * own drawing (Raster, GlyphAtlas) writes 24-bit color into it directly; whatever the
+     * graphics library draws arrives as RGB565, and is widened on the way in.
+     */
+    class Canvas888 : public Adafruit_GFX
     {
-        return static_cast<T>(
-            static_cast<unsigned>(t1) & static_cast<unsigned>(t2)
-        );
-    }
+    public:
+        Canvas888(uint16_t w, uint16_t h)
+            : Adafruit_GFX(static_cast<int16_t>(w), static_cast<int16_t>(h)),
+              _buffer(new (std::nothrow) Color[static_cast<size_t>(w) * h]())
+        {
+        }
 
-    template<typename T>
-    constexpr T operator|(const T& t1, const T& t2)
-    {
-        return static_cast<T>(
-            static_cast<unsigned>(t1) | static_cast<unsigned>(t2)
-        );
-    }
+        Color* getBuffer() const noexcept { return _buffer.get(); }
 
-    template<typename T>
-    T constexpr operator~(const T& t1)
-    {
-        return static_cast<T>(
-            ~static_cast<unsigned>(t1)
-        );
-    }
+        void drawPixel(int16_t x, int16_t y, uint16_t color) override
+        {
+            if (!_buffer || x < 0 || y < 0 || x >= width() || y >= height()) {
+                return;
+            }
+            int16_t t;
+            switch (getRotation()) {
+                case 1: t = x; x = WIDTH - 1 - y; y = t; break;
+                case 2: x = WIDTH - 1 - x; y = HEIGHT - 1 - y; break;
+                case 3: t = x; x = y; y = HEIGHT - 1 - t; break;
+                default: break;
+            }
+            _buffer[(static_cast<size_t>(y) * WIDTH) + x] = PixelFormat::rgb565To888(color);
+#  if defined(EWM_ADAFRUIT_HEADLESS)
+            countPixelsDrawn(1U);
+#  endif
+        }
 
-    template<typename T1, typename T2>
-    inline bool bitsHigh(const T1& bitmask, const T2& bits) noexcept
-    {
-        return (bitmask & bits) == bits;
-    }
+        void fillScreen(uint16_t color) override
+        {
+            if (_buffer) {
+                std::fill_n(_buffer.get(), static_cast<size_t>(WIDTH) * HEIGHT,
+                    PixelFormat::rgb565To888(color));
+#  if defined(EWM_ADAFRUIT_HEADLESS)
+                countPixelsDrawn(static_cast<uint32_t>(WIDTH) * HEIGHT);
+#  endif
+            }
+        }
 
-    using Mutex     = std::recursive_mutex;
-    using ScopeLock = std::scoped_lock<Mutex>;
+#  if defined(EWM_ADAFRUIT_HEADLESS)
+        // See HeadlessCanvas.
+        void countPixelsDrawn(uint32_t pixels) noexcept
+        {
+            HeadlessCanvas::countTotalPixelsDrawn(pixels);
+        }
+#  endif
 
-    enum class Message : uint8_t
-    {
-        None     = 0,
-        Create   = 1,
-        Destroy  = 2,
-        Draw     = 3,
-        PostDraw = 4,
-        Input    = 5,
-        Event    = 6,
-        Resize   = 7
+    protected:
+        std::unique_ptr<Color[]> _buffer;
     };
 
-    enum class Style : uint32_t
-    {
-        None       = 0,
-        Visible    =  1 << 0,
-        Child      =  1 << 1,
-        Frame      =  1 << 2,
-        Shadow     =  1 << 3,
-        TopLevel   = (1 << 4) | Frame | Shadow,
-        AutoSize   =  1 << 5,
-        FullScreen =  1 << 6,
-        Button     =  1 << 7,
-        Label      =  1 << 8,
-        Prompt     =  (1 << 9) | TopLevel,
-        Progress   =  1 << 10,
-        CheckBox   =  1 << 11
-    };
+    using IGfxContext = Canvas888;
+# else
+    using IGfxContext = IGfxContext16;
+# endif
 
-    enum class State : uint16_t
+    /**
+     * Off-screen canvas of the graphics library, plus an optional clip rect (in
+     * canvas coordinates). While a clip rect is set, Raster and the theme draw
+     * nothing outside of it; under EWM_GFX_ADAFRUIT, neither does the library.
+     */
+    class GfxCanvas : public IGfxContext
     {
-        None    = 0,      /**< Invalid state. */
-        Alive   = 1 << 0, /**< Active (not yet destroyed). */
-        Checked = 1 << 1, /**< Checked/highlighted item. */
-        Dirty   = 1 << 2  /**< Needs redrawing. */
-    };
+    public:
+        using IGfxContext::IGfxContext;
 
-    enum class ProgressStyle : uint8_t
-    {
-        Normal        = 1 << 0, /**< Standard linear-fill progress bar. */
-        Indeterminate = 1 << 1  /**< Marquee-style progress bar. */
-    };
-
-    enum class DrawText : uint8_t
-    {
-        Center   = 1 << 0, /**< Horizontal align center. */
-        Single   = 1 << 1, /**< Single line of text. */
-        Clip     = 1 << 2, /**< Text outside the rect will not be drawn. */
-        Ellipsis = 1 << 3  /**< Replace clipped text with '...' */
-    };
-
-    enum class EventType : uint8_t
-    {
-        ChildTapped = 1
-    };
-
-    enum class InputType : uint8_t
-    {
-        None = 0,
-        Tap  = 1
-    };
-
-    struct InputParams
-    {
-# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-        std::string handledBy;
-# endif
-        InputType type = InputType::None;
-        Coord x = 0;
-        Coord y = 0;
-    };
-
-    static MsgParam makeMsgParam(const MsgParamWord& hiWord, const MsgParamWord& loWord)
-    {
-        return (static_cast<MsgParam>(hiWord) << 16) | (loWord & 0xffffU);
-    }
-
-    static MsgParamWord getMsgParamHiWord(const MsgParam& msgParam)
-    {
-        return ((msgParam >> 16) & 0xffffU);
-    }
+        bool hasClipRect() const noexcept { return _clipped; }
 
-    static MsgParamWord getMsgParamLoWord(const MsgParam& msgParam)
-    {
-        return (msgParam & 0xffffU);
-    }
+        /** Returns the clip rect, or the bounds of the canvas if there isn't one. */
+        Rect getClipRect() const noexcept
+        {
+            return _clipped ? _clip : Rect(0, 0, width(), height());
+        }
 
-    enum class ColorID : uint8_t
-    {
-        Screensaver = 1,
+        void setClipRect(const Rect& rect) noexcept
+        {
+            _clip    = rect;
+            _clipped = true;
+        }
 
-        PromptBg,
-        PromptFrame,
-        PromptShadow,
+        void resetClipRect() noexcept { _clipped = false; }
 
-        WindowText,
-        WindowBg,
-        WindowFrame,
-        WindowShadow,
+        /** Whether any part of the given rect lies within the clip rect. */
+        bool intersectsClipRect(int32_t x, int32_t y, int32_t w, int32_t h) const noexcept
+        {
+            return !_clipped || (w > 0 && h > 0 && x < _clip.right && x + w > _clip.left &&
+                y < _clip.bottom && y + h > _clip.top);
+        }
 
-        ButtonText,
-        ButtonTextPressed,
-        ButtonBg,
-        ButtonBgPressed,
-        ButtonFrame,
-        ButtonFramePressed,
+# if defined(EWM_GFX_ADAFRUIT)
+        void drawPixel(int16_t x, int16_t y, uint16_t color) override
+        {
+            if (!_clipped || (x >= _clip.left && x < _clip.right && y >= _clip.top &&
+                y < _clip.bottom)) {
+                IGfxContext::drawPixel(x, y, color);
+            }
+        }
 
-        ProgressBg,
-        ProgressFill,
+        void fillScreen(uint16_t color) override
+        {
+            if (_clipped) {
+                fillRect(_clip.left, _clip.top, _clip.width(), _clip.height(), color);
+                return;
+            }
+            IGfxContext::fillScreen(color);
+        }
 
-        CheckBoxCheckBg,
-        CheckBoxCheckFrame,
-        CheckBoxCheck
-    };
+        void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override
+        {
+            if (!_clipped) {
+                IGfxContext::fillRect(x, y, w, h, color);
+                return;
+            }
+            const int16_t left   = std::max<int32_t>(x, _clip.left);
+            const int16_t top    = std::max<int32_t>(y, _clip.top);
+            const int16_t right  = std::min<int32_t>(x + w, _clip.right);
+            const int16_t bottom = std::min<int32_t>(y + h, _clip.bottom);
+            if (right > left && bottom > top) {
+                IGfxContext::fillRect(left, top, right - left, bottom - top, color);
+            }
+        }
 
-    enum class MetricID : uint8_t
-    {
-        XPadding = 1,             /**< Extent */
-        YPadding,                 /**< Extent */
+        void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override
+        {
+            if (!_clipped) {
+                IGfxContext::drawFastHLine(x, y, w, color);
+                return;
+            }
+            if (y < _clip.top || y >= _clip.bottom) {
+                return;
+            }
+            if (w < 0) {
+                x += w + 1;
+                w = -w;
+            }
+            const int16_t begin = std::max<int32_t>(x, _clip.left);
+            const int16_t end   = std::min<int32_t>(x + w, _clip.right);
+            if (end > begin) {
+                IGfxContext::drawFastHLine(begin, y, end - begin, color);
+            }
+        }
 
-        DefTextSize,              /**< uint8_t */
+        void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override
+        {
+            if (!_clipped) {
+                IGfxContext::drawFastVLine(x, y, h, color);
+                return;
+            }
+            if (x < _clip.left || x >= _clip.right) {
+                return;
+            }
+            if (h < 0) {
+                y += h + 1;
+                h = -h;
+            }
+            const int16_t begin = std::max<int32_t>(y, _clip.top);
+            const int16_t end   = std::min<int32_t>(y + h, _clip.bottom);
+            if (end > begin) {
+                IGfxContext::drawFastVLine(x, begin, end - begin, color);
+            }
+        }
+# endif
 
-        WindowFramePx,            /**< Extent */
-        CornerRadiusWindow,       /**< Coord */
-        CornerRadiusButton,       /**< Coord */
-        CornerRadiusPrompt,       /**< Coord */
-        CornerRadiusCheckBox,     /**< Coord */
+        /** Returns the value of millis() as of the last call to markUsed(). */
+        uint32_t getLastUsed() const noexcept { return _lastUsed; }
 
-        DefButtonCX,              /**< Extent */
-        DefButtonCY,              /**< Extent */
-        ButtonLabelPadding,       /**< Extent */
-        ButtonTappedDuration,     /**< uint32_t */
+        void markUsed() noexcept
+        {
+            _lastUsed = millis();
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+            _incompressible = false;
+# endif
+        }
 
-        MaxPromptCX,              /**< Extent */
-        MaxPromptCY,              /**< Extent */
+        /** Bytes allocated for the pixels (or, while compressed, for the runs). */
+        size_t getBufferSize() const noexcept
+        {
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+            if (isCompressed()) {
+                return _runCount * sizeof(Run);
+            }
+# endif
+            return static_cast<size_t>(WIDTH) * HEIGHT * sizeof(Color);
+        }
 
-        DefProgressHeight,        /**< Extent */
-        ProgressMarqueeCXFactor,  /**< float */
-        ProgressMarqueeStep,      /**< float */
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+        ~GfxCanvas() { _freeRuns(); }
+
+        /** Whether the pixels are run-length encoded (and the buffer released). */
+        bool isCompressed() const noexcept { return _runs != nullptr; }
+
+        /**
+         * Whether compress() is worth calling: the context isn't compressed, and it
+         * hasn't failed to compress since it was last used.
+         */
+        bool isCompressible() const noexcept { return !isCompressed() && !_incompressible; }
+
+        /**
+         * Encodes the pixels as runs of one color, and releases the buffer. Returns the
+         * number of bytes freed, or 0 if the runs wouldn't take up less than half of the
+         * buffer, or couldn't be allocated (in which case nothing changes, and the
+         * context isn't compressible until it's used again).
+         */
+        size_t compress()
+        {
+            const Color* pixels = _getPixels();
+            if (isCompressed() || pixels == nullptr) {
+                return 0U;
+            }
+            const size_t count    = _pixelCount();
+            const size_t rawBytes = count * sizeof(Color);
+            const size_t maxRuns  = rawBytes / 2U / sizeof(Run);
+            // The runs are counted before anything is allocated, giving up as soon as
+            // there are too many of them.
+            size_t runs = 0U;
+            for (size_t i = 0U; i < count; i += _runLength(pixels + i, count - i)) {
+                if (++runs > maxRuns) {
+                    _incompressible = true;
+                    return 0U;
+                }
+            }
+            _runs = static_cast<Run*>(_allocRuns(runs * sizeof(Run)));
+            if (_runs == nullptr) {
+                EWM_LOG_W("failed to allocate %zu bytes for %zu runs", runs * sizeof(Run),
+                    runs);
+                _incompressible = true;
+                return 0U;
+            }
+            for (size_t i = 0U, run = 0U; i < count; run++) {
+                const auto length = _runLength(pixels + i, count - i);
+                _runs[run] = Run { pixels[i], length };
+                i += length;
+            }
+            _runCount = runs;
+            _freePixels();
+            return rawBytes - (runs * sizeof(Run));
+        }
 
-        DefCheckBoxHeight,        /**< Extent */
-        CheckBoxCheckAreaPadding, /**< Extent */
-        CheckBoxCheckMarkPadding, /**< Extent */
-        CheckBoxCheckDelay        /**< uint32_t */
-    };
+        /**
+         * Reallocates the buffer and decodes the runs into it. Returns false if the
+         * buffer couldn't be allocated (the context then remains compressed).
+         */
+        bool decompress()
+        {
+            if (!isCompressed()) {
+                return true;
+            }
+            if (!_allocPixels()) {
+                EWM_LOG_E("failed to allocate %zu byte buffer for %hdx%hd context",
+                    _pixelCount() * sizeof(Color), WIDTH, HEIGHT);
+                return false;
+            }
+            Color* pixels = _getPixels();
+            for (size_t run = 0U; run < _runCount; run++) {
+                pixels = std::fill_n(pixels, _runs[run].length, _runs[run].color);
+            }
+            _freeRuns();
+            return true;
+        }
+# endif
 
-    struct Variant
-    {
-        enum class Type : uint8_t
+    private:
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+        struct Run
         {
-            Empty  = 0,
-            Extent = 1,
-            Coord  = 2,
-            UInt8  = 3,
-            UInt32 = 4,
-            Float  = 5
+            Color color;
+            uint16_t length;
         };
 
-        Variant() = default;
-
-        Type getType() const noexcept { return _type; }
+        size_t _pixelCount() const noexcept { return static_cast<size_t>(WIDTH) * HEIGHT; }
 
-        Extent getExtent() const noexcept
+        static uint16_t _runLength(const Color* pixels, size_t count) noexcept
         {
-            EWM_ASSERT(_type == Type::Extent);
-            return _extentValue;
+            const size_t limit = std::min<size_t>(count, UINT16_MAX);
+            size_t length = 1U;
+            while (length < limit && pixels[length] == pixels[0]) {
+                length++;
+            }
+            return static_cast<uint16_t>(length);
         }
 
-        void setExtent(const Extent& extent) noexcept
+        // The buffer is released and reallocated just as the graphics library itself
+        // would (which frees it upon destruction).
+        Color* _getPixels() const noexcept
         {
-            _extentValue = extent;
-            _type = Type::Extent;
+#  if defined(EWM_COLOR_888)
+            return _buffer.get();
+#  elif defined(EWM_GFX_ADAFRUIT)
+            return buffer;
+#  else
+            return _framebuffer;
+#  endif
         }
 
-        Coord getCoord() const noexcept
+        bool _allocPixels()
         {
-            EWM_ASSERT(_type == Type::Coord);
-            return _coordValue;
+#  if defined(EWM_COLOR_888)
+            _buffer.reset(new (std::nothrow) Color[_pixelCount()]);
+#  elif defined(EWM_GFX_ADAFRUIT)
+            buffer = static_cast<uint16_t*>(malloc(_pixelCount() * sizeof(uint16_t)));
+#  else
+            _framebuffer = static_cast<uint16_t*>(malloc(_pixelCount() * sizeof(uint16_t)));
+#  endif
+            return _getPixels() != nullptr;
         }
 
-        void setCoord(const Coord& coord) noexcept
+        void _freePixels()
         {
-            _coordValue = coord;
-            _type = Type::Coord;
+#  if defined(EWM_COLOR_888)
+            _buffer.reset();
+#  elif defined(EWM_GFX_ADAFRUIT)
+            free(buffer);
+            buffer = nullptr;
+#  else
+            free(_framebuffer);
+            _framebuffer = nullptr;
+#  endif
         }
 
-        uint8_t getUint8() const noexcept
+        static void* _allocRuns(size_t bytes)
         {
-            EWM_ASSERT(_type == Type::UInt8);
-            return _uint8Value;
+#  if defined(ESP32)
+            return heap_caps_malloc_prefer(bytes, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+#  else
+            return malloc(bytes);
+#  endif
         }
 
-        void setUint8(const uint8_t& octet) noexcept
+        void _freeRuns() noexcept
         {
-            _uint8Value = octet;
-            _type = Type::UInt8;
+#  if defined(ESP32)
+            heap_caps_free(_runs);
+#  else
+            free(_runs);
+#  endif
+            _runs     = nullptr;
+            _runCount = 0U;
         }
 
-        uint32_t getUint32() const noexcept
-        {
-            EWM_ASSERT(_type == Type::UInt32);
-            return _uint32Value;
-        }
+        Run* _runs           = nullptr;
+        size_t _runCount     = 0U;
+        bool _incompressible = false;
+# endif
+        Rect _clip;
+        uint32_t _lastUsed = 0U;
+        bool _clipped = false;
+    };
 
-        void setUint32(const uint32_t& dword) noexcept
+    /**
+     * Narrows the clip rect of a graphics context for as long as it's in scope, and
+     * then restores the previous one.
+     */
+    class ScopedClipRect
+    {
+    public:
+        ScopedClipRect(const GfxContextPtr& ctx, const Rect& rect)
+            : _ctx(ctx), _prevClip(ctx->getClipRect()), _hadClip(ctx->hasClipRect())
         {
-            _uint32Value = dword;
-            _type = Type::UInt32;
+            EWM_ASSERT(_ctx);
+            _ctx->setClipRect(_hadClip ? rect.getIntersection(_prevClip) : rect);
         }
 
-        float getFloat() const noexcept
-        {
-            EWM_ASSERT(_type == Type::Float);
-            return _floatValue;
-        }
+        ScopedClipRect(const ScopedClipRect&) = delete;
+        ScopedClipRect& operator=(const ScopedClipRect&) = delete;
 
-        void setFloat(const float& flt) noexcept
+        ~ScopedClipRect()
         {
-            _floatValue = flt;
-            _type = Type::Float;
+            if (_hadClip) {
+                _ctx->setClipRect(_prevClip);
+            } else {
+                _ctx->resetClipRect();
+            }
         }
 
     private:
-        union
-        {
-            Extent _extentValue;
-            Coord _coordValue;
-            uint8_t _uint8Value;
-            uint32_t _uint32Value;
-            float _floatValue = 0.0f;
-        };
-        Type _type = Type::Empty;
+        GfxContextPtr _ctx;
+        Rect _prevClip;
+        bool _hadClip = false;
     };
 
-    class ITheme
+    /**
+     * A set of disjoint rects (e.g. the damaged area of a window or the display),
+     * stored inline so that region algebra never touches the heap. If an operation
+     * would require more than MaxRects rects, the region is approximated (never
+     * understated) by merging rects into their bounding box.
+     */
+    class Region
     {
     public:
-        enum class DisplaySize : uint8_t
-        {
-            Small = 0,
-            Medium,
-            Large
-        };
+        static constexpr size_t MaxRects = EWM_REGION_MAX_RECTS;
+        static_assert(MaxRects >= 4U, "a rect less another may take up to four");
 
-        virtual void setDisplayExtents(Extent, Extent) = 0;
+        Region() = default;
 
-        virtual Color getColor(ColorID) const = 0;
-        virtual Variant getMetric(MetricID) const = 0;
+        explicit Region(const Rect& rect)
+        {
+            unite(rect);
+        }
 
-        virtual void drawScreensaver(const GfxDisplayPtr&) const = 0;
+        bool empty() const noexcept { return _count == 0U; }
+        size_t size() const noexcept { return _count; }
+        void clear() noexcept { _count = 0U; }
 
-        virtual void setDefaultFont(const Font*) = 0;
-        virtual const Font* getDefaultFont() const = 0;
+        const Rect* begin() const noexcept { return _rects.data(); }
+        const Rect* end() const noexcept { return _rects.data() + _count; }
 
-        virtual DisplaySize getDisplaySize() const = 0;
-        virtual Extent getScaledValue(Extent) const = 0;
+        const Rect& operator[](size_t idx) const noexcept
+        {
+            EWM_ASSERT(idx < _count);
+            return _rects[idx];
+        }
 
-        virtual void drawWindowFrame(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
-        virtual void drawWindowShadow(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
-        virtual void drawWindowBackground(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
-        virtual void drawText(const GfxContextPtr&, const char*, DrawText, const Rect&,
-            uint8_t, Color, const Font*) const = 0;
+        Rect getBounds() const noexcept
+        {
+            if (empty()) {
+                return Rect();
+            }
+            auto bounds = _rects[0];
+            for (size_t idx = 1U; idx < _count; idx++) {
+                bounds.mergeRect(_rects[idx]);
+            }
+            return bounds;
+        }
 
-        virtual void drawProgressBarBackground(const GfxContextPtr&, const Rect&) const = 0;
-        virtual void drawProgressBarProgress(const GfxContextPtr&, const Rect&, float) const = 0;
-        virtual void drawProgressBarIndeterminate(const GfxContextPtr&, const Rect&, float) const = 0;
+        uint32_t getArea() const noexcept
+        {
+            uint32_t area = 0U;
+            for (const auto& rect : *this) {
+                area += _area(rect);
+            }
+            return area;
+        }
 
-        virtual void drawCheckBox(const GfxContextPtr&, const char*, bool, const Rect&) const = 0;
-    };
-
-    using ThemePtr = std::shared_ptr<ITheme>;
-
-    class DefaultTheme : public ITheme
-    {
-    public:
-        DefaultTheme() = default;
+        bool intersectsRect(const Rect& rect) const noexcept
+        {
+            for (const auto& mine : *this) {
+                if (_overlaps(mine, rect)) {
+                    return true;
+                }
+            }
+            return false;
+        }
 
-        void setDisplayExtents(Extent width, Extent height) final
+        void unite(const Rect& rect) noexcept
         {
-            _displayWidth  = width;
-            _displayHeight = height;
+            if (_isEmpty(rect)) {
+                return;
+            }
+            // Only the parts of the rect not already in the region are added.
+            Region pieces;
+            pieces._rects[0] = rect;
+            pieces._count    = 1U;
+            bool exact = true;
+            for (const auto& mine : *this) {
+                if (!pieces.subtract(mine)) {
+                    exact = false;
+                    break;
+                }
+                if (pieces.empty()) {
+                    return;
+                }
+            }
+            if (exact && _count + pieces._count <= MaxRects) {
+                for (const auto& piece : pieces) {
+                    _rects[_count++] = piece;
+                }
+            } else {
+                auto bounds = getBounds();
+                bounds.mergeRect(rect);
+                _rects[0] = bounds;
+                _count    = 1U;
+            }
         }
 
-        Color getColor(ColorID colorID) const final
+        void unite(const Region& other) noexcept
         {
-            switch (colorID) {
-                case ColorID::Screensaver:        return 0x0000;
-                case ColorID::PromptBg:           return 0xef5c;
-                case ColorID::PromptFrame:        return 0x9cf3;
-                case ColorID::PromptShadow:       return 0xb5b6;
-                case ColorID::WindowText:         return 0x0000;
-                case ColorID::WindowBg:           return 0xdedb;
-                case ColorID::WindowFrame:        return 0x9cf3;
-                case ColorID::WindowShadow:       return 0xb5b6;
-                case ColorID::ButtonText:         return 0xffff;
-                case ColorID::ButtonTextPressed:  return 0xffff;
-                case ColorID::ButtonBg:           return 0x8c71;
-                case ColorID::ButtonBgPressed:    return 0x738e;
-                case ColorID::ButtonFrame:        return 0x6b6d;
-                case ColorID::ButtonFramePressed: return 0x6b6d;
-                case ColorID::ProgressBg:         return 0xef5d;
-                case ColorID::ProgressFill:       return 0x0ce0;
-                case ColorID::CheckBoxCheckBg:    return 0xef5d;
-                case ColorID::CheckBoxCheck:      return 0x3166;
-                case ColorID::CheckBoxCheckFrame: return 0x9cf3;
-                default:
-                    EWM_ASSERT("!invalid color ID");
-                    return Color(0);
+            for (const auto& rect : other) {
+                unite(rect);
             }
         }
 
-        Variant getMetric(MetricID metricID) const final
+        /**
+         * Adds the rect by merging it (and the result, repeatedly) into the bounding
+         * box of any rect it overlaps or lies within `slop` pixels of. Unlike unite(),
+         * never splits rects, so the region stays a short list of simple boxes.
+         */
+        void mergeRect(const Rect& rect, Extent slop = 0) noexcept
         {
-            Variant retval;
-            switch (metricID) {
-                case MetricID::XPadding:
-                    retval.setExtent(abs(_displayWidth * 0.05f));
-                break;
-                case MetricID::YPadding:
-                    retval.setExtent(abs(_displayHeight * 0.05f));
-                break;
-                case MetricID::DefTextSize:
-                    retval.setUint8(1);
-                break;
-                case MetricID::WindowFramePx:
-                    retval.setExtent(1);
-                break;
-                case MetricID::CornerRadiusWindow:
-                    retval.setCoord(0);
-                break;
-                case MetricID::CornerRadiusButton:
-                    retval.setCoord(getScaledValue(4));
-                break;
-                case MetricID::CornerRadiusPrompt:
-                    retval.setCoord(getScaledValue(4));
-                break;
-                case MetricID::CornerRadiusCheckBox:
-                    retval.setCoord(getScaledValue(0));
-                break;
-                case MetricID::DefButtonCX:
-                    retval.setExtent(abs(max(_displayWidth * 0.19f, 60.0f)));
-                break;
-                case MetricID::DefButtonCY: {
-                    const auto btnWidth = getMetric(MetricID::DefButtonCX).getExtent();
-                    retval.setExtent(abs(btnWidth * 0.52f));
+            if (_isEmpty(rect)) {
+                return;
+            }
+            auto merged = rect;
+            while (true) {
+                bool absorbed = false;
+                for (size_t idx = 0U; idx < _count;) {
+                    if (_near(_rects[idx], merged, slop)) {
+                        merged.mergeRect(_rects[idx]);
+                        _rects[idx] = _rects[--_count];
+                        absorbed = true;
+                    } else {
+                        idx++;
+                    }
                 }
-                break;
-                case MetricID::ButtonLabelPadding:
-                    retval.setExtent(getScaledValue(10));
-                break;
-                case MetricID::ButtonTappedDuration:
-                    retval.setUint32(200);
-                break;
-                case MetricID::MaxPromptCX:
-                    retval.setExtent(abs(_displayWidth * 0.75f));
-                break;
-                case MetricID::MaxPromptCY:
-                    retval.setExtent(abs(_displayHeight * 0.75f));
-                break;
-                case MetricID::DefProgressHeight:
-                    retval.setExtent(abs(_displayHeight * 0.10f));
-                break;
-                case MetricID::ProgressMarqueeCXFactor:
-                    retval.setFloat(0.33f);
-                break;
-                case MetricID::ProgressMarqueeStep: {
-                    static constexpr float step = 1.0f;
-                    switch (getDisplaySize()) {
-                        case DisplaySize::Small:
-                            retval.setFloat(step);
-                        break;
-                        case DisplaySize::Medium:
-                            retval.setFloat(step * 2.0f);
-                        break;
-                        case DisplaySize::Large:
-                            retval.setFloat(step * 4.0f);
-                        break;
-                        default:
-                            EWM_ASSERT(!"invalid display size");
-                            retval.setFloat(step);
-                        break;
+                if (absorbed) {
+                    continue;
+                }
+                if (_count < MaxRects) {
+                    break;
+                }
+                // Out of room: fold into whichever rect grows the least.
+                size_t best = 0U;
+                uint32_t bestGrowth = UINT32_MAX;
+                for (size_t idx = 0U; idx < _count; idx++) {
+                    auto bounds = _rects[idx];
+                    bounds.mergeRect(merged);
+                    const auto growth = _area(bounds) - _area(_rects[idx]);
+                    if (growth < bestGrowth) {
+                        bestGrowth = growth;
+                        best       = idx;
                     }
                 }
-                break;
-                case MetricID::DefCheckBoxHeight:
-                    retval.setExtent(abs(_displayHeight * 0.10f));
-                break;
-                case MetricID::CheckBoxCheckAreaPadding:
-                    retval.setExtent(getScaledValue(2));
-                break;
-                case MetricID::CheckBoxCheckMarkPadding:
-                    retval.setExtent(getScaledValue(2));
-                break;
-                case MetricID::CheckBoxCheckDelay:
-                    retval.setUint32(200);
-                break;
-                default:
-                    EWM_ASSERT(!"invalid metric ID");
-                break;
+                merged.mergeRect(_rects[best]);
+                _rects[best] = _rects[--_count];
             }
-            return retval;
+            _rects[_count++] = merged;
         }
 
-        void drawScreensaver(const GfxDisplayPtr& display) const final
+        /** Moves the latter half of the rects into the returned region. */
+        Region split() noexcept
         {
-            EWM_ASSERT(display);
-            display->fillScreen(getColor(ColorID::Screensaver));
+            Region half;
+            const auto keep = (_count + 1U) / 2U;
+            for (size_t idx = keep; idx < _count; idx++) {
+                half._rects[half._count++] = _rects[idx];
+            }
+            _count = keep;
+            return half;
         }
 
-        void setDefaultFont(const Font* font) final
+        /** Returns false if the result had to be approximated. */
+        bool subtract(const Rect& rect) noexcept
         {
-            _defaultFont = font;
+            if (_isEmpty(rect)) {
+                return true;
+            }
+            bool exact = true;
+            std::array<Rect, MaxRects> result;
+            size_t count = 0U;
+            for (size_t idx = 0U; idx < _count; idx++) {
+                const auto& mine = _rects[idx];
+                if (!_overlaps(mine, rect)) {
+                    result[count++] = mine;
+                    continue;
+                }
+                std::array<Rect, 4> split;
+                const auto pieces = _split(mine, rect, split);
+                // Room must be left for each of the rects not yet visited.
+                if (count + pieces + (_count - idx - 1U) > MaxRects) {
+                    // Keep the rect intact, and let the caller know the result
+                    // is a superset of the exact one.
+                    result[count++] = mine;
+                    exact = false;
+                    continue;
+                }
+                for (size_t piece = 0U; piece < pieces; piece++) {
+                    result[count++] = split[piece];
+                }
+            }
+            _rects = result;
+            _count = count;
+            return exact;
         }
 
-        const Font* getDefaultFont() const final { return _defaultFont; }
-
-        DisplaySize getDisplaySize() const final
+        bool subtract(const Region& other) noexcept
         {
-            if (_displayWidth <= 320 && _displayHeight <= 320) {
-                return DisplaySize::Small;
-            } else if (_displayWidth <= 480 && _displayHeight <= 480) {
-                return DisplaySize::Medium;
-            } else {
-                return DisplaySize::Large;
+            bool exact = true;
+            for (const auto& rect : other) {
+                exact &= subtract(rect);
             }
+            return exact;
         }
 
-        Extent getScaledValue(Extent value) const final
+        void intersect(const Rect& rect) noexcept
         {
-            switch (getDisplaySize()) {
-                case DisplaySize::Small:
-                    return abs(value * 1.0f);
-                case DisplaySize::Medium:
-                    return abs(value * 2.0f);
-                case DisplaySize::Large:
-                    return abs(value * 3.0f);
-                default:
-                    EWM_ASSERT(!"invalid display size");
-                    return value;
+            size_t count = 0U;
+            for (size_t idx = 0U; idx < _count; idx++) {
+                if (_overlaps(_rects[idx], rect)) {
+                    _rects[count++] = Rect(
+                        max(_rects[idx].left, rect.left),
+                        max(_rects[idx].top, rect.top),
+                        min(_rects[idx].right, rect.right),
+                        min(_rects[idx].bottom, rect.bottom)
+                    );
+                }
             }
+            _count = count;
         }
 
-        void drawWindowFrame(const GfxContextPtr& ctx, const Rect& rect,
-            Coord radius, Color color) const final
-        {
-            auto tmp = rect;
-            auto pixels = getMetric(MetricID::WindowFramePx).getExtent();
-            while (pixels-- > 0) {
-                EWM_ASSERT(ctx);
-                ctx->drawRoundRect(tmp.left, tmp.top, tmp.width(), tmp.height(), radius, color);
-                tmp.deflate(1);
+        /** Merges rects which share an entire edge, until no more can be merged. */
+        void coalesce() noexcept
+        {
+            bool merged = true;
+            while (merged) {
+                merged = false;
+                for (size_t outer = 0U; outer < _count && !merged; outer++) {
+                    for (size_t inner = outer + 1U; inner < _count; inner++) {
+                        auto& a = _rects[outer];
+                        const auto& b = _rects[inner];
+                        const bool horizontal = a.top == b.top && a.bottom == b.bottom &&
+                            (a.right == b.left || b.right == a.left);
+                        const bool vertical = a.left == b.left && a.right == b.right &&
+                            (a.bottom == b.top || b.bottom == a.top);
+                        if (horizontal || vertical) {
+                            a.mergeRect(b);
+                            _rects[inner] = _rects[--_count];
+                            merged = true;
+                            break;
+                        }
+                    }
+                }
             }
         }
 
-        void drawWindowShadow(const GfxContextPtr& ctx, const Rect& rect,
-            Coord radius, Color color) const final
+    private:
+        static bool _isEmpty(const Rect& rect) noexcept
         {
-            const auto thickness = getMetric(MetricID::WindowFramePx).getExtent();
-            EWM_ASSERT(ctx);
-            ctx->drawLine(
-                rect.left + radius + thickness,
-                rect.bottom,
-                rect.left + (rect.width() - (radius + (thickness * 2))),
-                rect.bottom,
-                color
-            );
-            ctx->drawLine(
-                rect.right,
-                rect.top + radius + thickness,
-                rect.right,
-                rect.top + (rect.height() - (radius + (thickness * 2))),
-                color
-            );
+            return rect.right <= rect.left || rect.bottom <= rect.top;
         }
 
-        void drawWindowBackground(const GfxContextPtr& ctx, const Rect& rect,
-            Coord radius, Color color) const final
+        static bool _overlaps(const Rect& a, const Rect& b) noexcept
         {
-            EWM_ASSERT(ctx);
-            ctx->fillRoundRect(rect.left, rect.top, rect.width(), rect.height(),
-                radius, color);
+            return a.left < b.right && b.left < a.right &&
+                   a.top < b.bottom && b.top < a.bottom;
         }
 
-        void drawText(const GfxContextPtr& ctx, const char* text, DrawText flags,
-            const Rect& rect, uint8_t textSize, Color textColor, const Font* font) const final
+        static bool _near(const Rect& a, const Rect& b, Extent slop) noexcept
         {
-            EWM_ASSERT(ctx);
-            ctx->setTextSize(textSize);
-            ctx->setFont(font);
+            const int32_t gap = slop;
+            return a.left < b.right + gap && b.left < a.right + gap &&
+                   a.top < b.bottom + gap && b.top < a.bottom + gap;
+        }
 
-            const bool xCenter = bitsHigh(flags, DrawText::Center);
-            const bool singleLine = bitsHigh(flags, DrawText::Single);
+        static uint32_t _area(const Rect& rect) noexcept
+        {
+            return static_cast<uint32_t>(rect.width()) * rect.height();
+        }
 
-            uint8_t xAdv    = 0;
-            uint8_t yAdv    = 0;
-            uint8_t yAdvMax = 0;
-            int8_t xOff     = 0;
-            int8_t yOff     = 0;
-            int8_t yOffMin  = 0;
-            Extent xAccum   = 0;
-            Extent yAccum   = 0;
-            if (singleLine) {
-                int16_t x  = 0;
-                int16_t y  = rect.top + (rect.height() / 2);
-                uint16_t w = 0;
-                uint16_t h = 0;
-                ctx->getTextBounds(text, rect.left, y, &x, &y, &w, &h);
-                yAccum = rect.top + (rect.height() / 2) + (h / 2) - 1;
-            } else {
-                yAccum = rect.top + getMetric(MetricID::YPadding).getExtent();
+        // Splits `rect` minus `hole` (which must overlap) into at most four rects.
+        static size_t _split(const Rect& rect, const Rect& hole, std::array<Rect, 4>& out) noexcept
+        {
+            size_t count = 0U;
+            if (hole.top > rect.top) {
+                out[count++] = Rect(rect.left, rect.top, rect.right, hole.top);
+            }
+            if (hole.bottom < rect.bottom) {
+                out[count++] = Rect(rect.left, hole.bottom, rect.right, rect.bottom);
             }
+            const auto top    = max(rect.top, hole.top);
+            const auto bottom = min(rect.bottom, hole.bottom);
+            if (hole.left > rect.left) {
+                out[count++] = Rect(rect.left, top, hole.left, bottom);
+            }
+            if (hole.right < rect.right) {
+                out[count++] = Rect(hole.right, top, rect.right, bottom);
+            }
+            return count;
+        }
 
-            const Extent xPadding =
-                ((singleLine && !xCenter) ? 0 : getMetric(MetricID::XPadding).getExtent());
-            const Extent xExtent = rect.right - xPadding;
-            const char* cursor = text;
+        std::array<Rect, MaxRects> _rects {};
+        size_t _count = 0U;
+    };
 
-            while (*cursor != '\0') {
-                xAccum = rect.left + xPadding;
-                const char* old_cursor = cursor;
-                std::deque<uint8_t> charXAdvs;
-                bool clipped = false;
-                while (xAccum <= xExtent && *cursor != '\0') {
-                    /// TODO: handle \n and \r
-                    getCharBounds(*cursor, nullptr, nullptr, &xAdv, &yAdv, &xOff,
-                        &yOff, textSize, font);
-                    if (xAccum + xAdv > xExtent) {
-                        if (singleLine && bitsHigh(flags, DrawText::Clip)) {
-                            clipped = true;
-                            break;
-                        }
-                        if (singleLine && bitsHigh(flags, DrawText::Ellipsis)) {
-                            auto it = charXAdvs.rbegin();
-                            if (it != charXAdvs.rend()) {
-                                clipped = true;
-                                xAccum -= (*it);
-                                charXAdvs.pop_back();
-                                cursor--;
-                                break;
-                            }
-                        }
-                    }
-                    charXAdvs.push_back(xAdv);
-                    xAccum += xAdv;
-                    cursor++;
-                    if (yAdv > yAdvMax) { yAdvMax = yAdv; }
-                    if (yOff > yOffMin) { yOffMin = yOff; }
-                }
-                size_t rewound = 0;
-                if (!singleLine) {
-                    for (size_t rewind = 0; rewind < (cursor - old_cursor); rewind++) {
-                        if (*(cursor - rewind) == ' ') {
-                            rewound = rewind;
-                            cursor -= rewind;
-                            while (rewind > 0) {
-                                xAccum -= charXAdvs.at(charXAdvs.size() - rewind);
-                                rewind--;
-                            }
-                            break;
-                        }
-                    }
-                }
-                const Extent drawnWidth = xAccum - (rect.left + xPadding);
-                xAccum = xCenter
-                    ? rect.left + (rect.width() / 2) - (drawnWidth / 2)
-                    : rect.left + xPadding;
-                while (old_cursor < cursor) {
-                    ctx->drawChar(
-                        xAccum,
-                        yAccum,
-                        *old_cursor++,
-                        textColor,
-                        textColor
+    inline Color* getGfxBuffer(const GfxContextPtr& ctx)
+    {
 # if defined(EWM_GFX_ADAFRUIT)
-                        , textSize
+        return ctx->getBuffer();
+# else
+        return ctx->getFramebuffer();
 # endif
-                    );
-                    xAccum += charXAdvs[
-                        charXAdvs.size() - 2 - ((cursor + rewound) - old_cursor - 1)
-                    ];
-                }
-                if (!singleLine) {
-                    if (rewound > 0) { cursor++; }
-                    yAccum += yAdvMax + yOffMin;
-                } else {
-                    if (clipped && bitsHigh(flags, DrawText::Ellipsis)) {
-                        getCharBounds('.', nullptr, nullptr, &xAdv, &yAdv,
-                            &xOff, &yOff, textSize, font);
-                        for (uint8_t ellipsis = 0; ellipsis < 3; ellipsis++) {
-                            ctx->drawChar(
-                                xAccum,
-                                yAccum,
-                                '.',
-                                textColor,
-                                textColor
+    }
+
+    inline GfxContextPtr createGfxContext(Extent width, Extent height)
+    {
 # if defined(EWM_GFX_ADAFRUIT)
-                                , textSize
+        return std::make_shared<GfxContext>(width, height);
+# else
+        auto ctx = std::make_shared<GfxContext>(width, height, nullptr, 0, 0);
+        EWM_ASSERT(ctx);
+        if (ctx) {
+            ctx->begin(GFX_SKIP_OUTPUT_BEGIN);
+        }
+        return ctx;
 # endif
-                            );
-                            xAccum += xAdv;
-                        }
-                    }
-                    break;
-                }
+    }
+
+# if !defined(EWM_NORASTER)
+    /**
+     * Raster kernels which write straight into the pixel buffer of a (non-rotated)
+     * graphics context, a row span at a time, rather than a pixel at a time by way of
+     * the graphics library's virtual drawPixel(). Everything is clipped to the context
+     * and its clip rect.
+     * Rounded rects come out pixel for pixel as the GFX libraries draw them. Each
+     * function returns false if it can't handle the context, in which case the caller
+     * should fall back on the library.
+     */
+    class Raster
+    {
+    public:
+        static bool fillRect(const GfxContextPtr& ctx, Coord x, Coord y, Coord w, Coord h,
+            Color color) noexcept
+        {
+            Surface surface;
+            if (w <= 0 || h <= 0 || !_getSurface(ctx, surface)) {
+                return false;
+            }
+            const Coord end = min(static_cast<Coord>(y + h), surface.bottom);
+            for (Coord row = max(y, surface.top); row < end; row++) {
+                surface.hline(x, row, w, color);
             }
+            surface.count(ctx);
+            return true;
         }
 
-        void drawProgressBarBackground(const GfxContextPtr& ctx, const Rect& rect) const final
+        static bool drawHLine(const GfxContextPtr& ctx, Coord x, Coord y, Coord w,
+            Color color) noexcept
         {
-            EWM_ASSERT(ctx);
-            ctx->fillRect(rect.left, rect.top, rect.width(), rect.height(),
-                getColor(ColorID::ProgressBg));
+            return fillRect(ctx, x, y, w, 1, color);
         }
 
-        void drawProgressBarProgress(const GfxContextPtr& ctx, const Rect& rect, float percent) const final
+        static bool drawVLine(const GfxContextPtr& ctx, Coord x, Coord y, Coord h,
+            Color color) noexcept
         {
-            EWM_ASSERT(percent >= 0.0f && percent <= 100.0f);
-            auto barRect = rect;
-            barRect.deflate(getMetric(MetricID::WindowFramePx).getExtent() * 2);
-            barRect.right = barRect.left + abs(barRect.width() * (min(100.0f, percent) / 100.0f));
-            EWM_ASSERT(ctx);
-            ctx->fillRect(barRect.left, barRect.top, barRect.width(),
-                barRect.height(), getColor(ColorID::ProgressFill));
+            Surface surface;
+            if (h <= 0 || !_getSurface(ctx, surface)) {
+                return false;
+            }
+            surface.vline(x, y, h, color);
+            surface.count(ctx);
+            return true;
         }
 
-        void drawProgressBarIndeterminate(const GfxContextPtr& ctx, const Rect& rect, float counter) const final
+        static bool fillRoundRect(const GfxContextPtr& ctx, Coord x, Coord y, Coord w,
+            Coord h, Coord r, Color color) noexcept
         {
-            EWM_ASSERT(counter >= 0.0f && counter <= 100.0f);
-            auto barRect = rect;
-            barRect.deflate(getMetric(MetricID::WindowFramePx).getExtent() * 2);
-            Extent marqueeWidth
-                = (barRect.width() * getMetric(MetricID::ProgressMarqueeCXFactor).getFloat());
-            Coord offset
-                = (barRect.width() + marqueeWidth) * (min(100.0f, counter) / 100.0f);
-            static Coord reverseOffset = marqueeWidth;
-            Coord x = 0;
-            Extent width = 0;
-            if (offset < marqueeWidth) {
-                x = barRect.left;
-                if (counter <= __FLT_EPSILON__) {
-                    reverseOffset = marqueeWidth;
+            Surface surface;
+            if (w <= 0 || h <= 0 || !_getSurface(ctx, surface)) {
+                return false;
+            }
+            r = _clampRadius(w, h, r);
+            if (r > MaxRadius) {
+                return false;
+            }
+            // Each corner is one quarter of a filled circle, drawn as vertical lines by
+            // the libraries: top[c] is how far above the corner's center the line c
+            // columns out from it begins (or -1 if there is none).
+            std::array<Coord, MaxRadius + 1> top;
+            _getCornerColumns(r, top);
+            const Coord end = min(h, static_cast<Coord>(surface.bottom - y));
+            for (Coord row = max(static_cast<Coord>(0), static_cast<Coord>(surface.top - y));
+                row < end; row++) {
+                const Coord need = max(static_cast<Coord>(0),
+                    static_cast<Coord>(max(r - row, row - (h - 1 - r))));
+                Coord reach = 0;
+                for (Coord c = r; c > 0; c--) {
+                    if (top[c] >= need) {
+                        reach = c;
+                        break;
+                    }
                 }
-                width = offset;
-            } else {
-                Coord realOffset = reverseOffset > 0
-                    ? offset - reverseOffset--
-                    : offset;
-                x = min(
-                    static_cast<Coord>(barRect.left + realOffset),
-                    barRect.right
-                );
-                width = min(
-                    marqueeWidth,
-                    static_cast<Extent>(barRect.right - x)
-                );
+                surface.hline(x + r - reach, y + row, w - (r * 2) + (reach * 2), color);
             }
-            EWM_ASSERT(ctx);
-            ctx->fillRect(x, barRect.top, width, barRect.height(),
-                getColor(ColorID::ProgressFill));
+            surface.count(ctx);
+            return true;
         }
 
-        void drawCheckBox(const GfxContextPtr& ctx, const char* lbl, bool checked, const Rect& rect) const final
+        static bool drawRoundRect(const GfxContextPtr& ctx, Coord x, Coord y, Coord w,
+            Coord h, Coord r, Color color) noexcept
         {
-            const auto radius = getMetric(MetricID::CornerRadiusCheckBox).getCoord();
-            drawWindowBackground(ctx, rect, radius, getColor(ColorID::WindowBg));
-            auto checkableRect = Rect(
-                rect.left,
-                rect.top + getMetric(MetricID::CheckBoxCheckAreaPadding).getExtent(),
-                rect.left + (rect.height() - (getMetric(MetricID::CheckBoxCheckAreaPadding).getExtent() * 2)),
-                rect.top + (rect.height() - getMetric(MetricID::CheckBoxCheckAreaPadding).getExtent())
-            );
-            checkableRect.top = rect.top + ((rect.height() / 2) - (checkableRect.height() / 2));
-            EWM_ASSERT(ctx);
-            ctx->fillRoundRect(
-                checkableRect.left,
-                checkableRect.top,
-                checkableRect.width(),
-                checkableRect.height(),
-                radius,
-                getColor(ColorID::CheckBoxCheckBg)
-            );
-            drawWindowFrame(ctx, checkableRect, radius, getColor(ColorID::CheckBoxCheckFrame));
-            if (checked) {
-                auto rectCheckMark = checkableRect;
-                rectCheckMark.deflate(getMetric(MetricID::CheckBoxCheckMarkPadding).getExtent());
-                ctx->fillRoundRect(
-                    rectCheckMark.left,
-                    rectCheckMark.top,
-                    rectCheckMark.width(),
-                    rectCheckMark.height(),
-                    radius,
-                    getColor(ColorID::CheckBoxCheck)
-                );
+            Surface surface;
+            if (w <= 0 || h <= 0 || !_getSurface(ctx, surface)) {
+                return false;
             }
-            Rect textRect(
-                checkableRect.right + (getMetric(MetricID::CheckBoxCheckMarkPadding).getExtent() * 2),
-                rect.top,
-                checkableRect.right + (rect.width() - checkableRect.width()),
-                rect.top + rect.height()
-            );
-            drawText(
-                ctx,
-                lbl,
-                DrawText::Single | DrawText::Ellipsis,
-                textRect,
-                getMetric(MetricID::DefTextSize).getUint8(),
-                getColor(ColorID::WindowText),
-                getDefaultFont()
-            );
+            r = _clampRadius(w, h, r);
+            surface.hline(x + r, y, w - (r * 2), color);
+            surface.hline(x + r, y + h - 1, w - (r * 2), color);
+            surface.vline(x, y + r, h - (r * 2), color);
+            surface.vline(x + w - 1, y + r, h - (r * 2), color);
+            // The corners, as the libraries' drawCircleHelper() plots them.
+            const Coord left   = x + r;
+            const Coord right  = x + w - r - 1;
+            const Coord upper  = y + r;
+            const Coord lower  = y + h - r - 1;
+            Coord f     = 1 - r;
+            Coord ddF_x = 1;
+            Coord ddF_y = -2 * r;
+            Coord cx    = 0;
+            Coord cy    = r;
+            while (cx < cy) {
+                if (f >= 0) {
+                    cy--;
+                    ddF_y += 2;
+                    f += ddF_y;
+                }
+                cx++;
+                ddF_x += 2;
+                f += ddF_x;
+                surface.pixel(right + cx, lower + cy, color);
+                surface.pixel(right + cy, lower + cx, color);
+                surface.pixel(right + cx, upper - cy, color);
+                surface.pixel(right + cy, upper - cx, color);
+                surface.pixel(left - cy, lower + cx, color);
+                surface.pixel(left - cx, lower + cy, color);
+                surface.pixel(left - cy, upper - cx, color);
+                surface.pixel(left - cx, upper - cy, color);
+            }
+            surface.count(ctx);
+            return true;
+        }
+
+        // Fills `count` pixels from `dst` on (two at a time, in RGB565).
+        static void fillSpan(Color* dst, size_t count, Color color) noexcept
+        {
+            if (count == 0U) {
+                return;
+            }
+# if defined(EWM_COLOR_888)
+            std::fill_n(dst, count, color);
+# else
+            if ((reinterpret_cast<uintptr_t>(dst) & 2U) != 0U) {
+                *dst++ = color;
+                count--;
+            }
+            const uint32_t pair = (static_cast<uint32_t>(color) << 16) | color;
+            auto words = reinterpret_cast<uint8_t*>(dst);
+            size_t pairs = count / 2U;
+            for (; pairs >= 4U; pairs -= 4U, words += 16) {
+                memcpy(words, &pair, 4U);
+                memcpy(words + 4, &pair, 4U);
+                memcpy(words + 8, &pair, 4U);
+                memcpy(words + 12, &pair, 4U);
+            }
+            for (; pairs > 0U; pairs--, words += 4) {
+                memcpy(words, &pair, 4U);
+            }
+            if ((count & 1U) != 0U) {
+                *reinterpret_cast<Color*>(words) = color;
+            }
+# endif
         }
 
     private:
-        Extent _displayWidth     = 0;
-        Extent _displayHeight    = 0;
-        const Font* _defaultFont = nullptr;
-    };
+        // Larger corners are left to the library.
+        static constexpr Coord MaxRadius = 64;
 
-    struct PackagedMessage
-    {
-        Message msg = Message::None;
-        MsgParam p1 = 0;
-        MsgParam p2 = 0;
-    };
+        struct Surface
+        {
+            Color* pixels   = nullptr;
+            Coord width     = 0;
+            Coord left      = 0; /**< Clip rect (never outside the context). */
+            Coord top       = 0;
+            Coord right     = 0;
+            Coord bottom    = 0;
+            uint32_t drawn  = 0U;
 
-    using PackagedMessageQueue = std::queue<PackagedMessage>;
+            void hline(Coord x, Coord y, Coord w, Color color) noexcept
+            {
+                if (y < top || y >= bottom) {
+                    return;
+                }
+                const Coord begin = max(x, left);
+                const Coord end   = min(static_cast<Coord>(x + w), right);
+                if (end > begin) {
+                    fillSpan(pixels + (static_cast<size_t>(y) * width) + begin,
+                        static_cast<size_t>(end - begin), color);
+                    drawn += end - begin;
+                }
+            }
 
-    class IWindow;
-    class IWindowContainer
-    {
-    public:
-        virtual bool hasChildren() = 0;
-        virtual size_t childCount() = 0;
-        virtual std::shared_ptr<IWindow> getChildByID(WindowID) = 0;
-        virtual bool setForegroundWindow(const std::shared_ptr<IWindow>&) = 0;
-        virtual void recalculateZOrder() = 0;
-        virtual bool addChild(const std::shared_ptr<IWindow>&) = 0;
-        virtual bool removeChildByID(WindowID) = 0;
-        virtual void removeAllChildren() = 0;
-        virtual void forEachChild(const std::function<bool(const std::shared_ptr<IWindow>&)>&) = 0;
-        virtual void forEachChildReverse(const std::function<bool(const std::shared_ptr<IWindow>&)>&) = 0;
-    };
+            void vline(Coord x, Coord y, Coord h, Color color) noexcept
+            {
+                if (x < left || x >= right) {
+                    return;
+                }
+                const Coord begin = max(y, top);
+                const Coord end   = min(static_cast<Coord>(y + h), bottom);
+                for (Coord row = begin; row < end; row++) {
+                    pixels[(static_cast<size_t>(row) * width) + x] = color;
+                }
+                if (end > begin) {
+                    drawn += end - begin;
+                }
+            }
 
-    class IWindow : public IWindowContainer
-    {
-    public:
-        virtual std::shared_ptr<IWindow> getParent() const = 0;
+            void pixel(Coord x, Coord y, Color color) noexcept
+            {
+                if (x >= left && x < right && y >= top && y < bottom) {
+                    pixels[(static_cast<size_t>(y) * width) + x] = color;
+                    drawn++;
+                }
+            }
 
-        virtual GfxContextPtr getGfxContext() const = 0;
+            void count([[maybe_unused]] const GfxContextPtr& ctx) noexcept
+            {
+#  if defined(EWM_ADAFRUIT_HEADLESS)
+                ctx->countPixelsDrawn(drawn);
+#  endif
+                drawn = 0U;
+            }
+        };
 
-        virtual Rect getRect() const noexcept = 0;
-        virtual void setRect(const Rect&) noexcept = 0;
+        static bool _getSurface(const GfxContextPtr& ctx, Surface& surface) noexcept
+        {
+            if (!ctx || ctx->getRotation() != 0) {
+                return false;
+            }
+            const auto clip = ctx->getClipRect();
+            surface.pixels  = getGfxBuffer(ctx);
+            surface.width   = ctx->width();
+            surface.left    = max(clip.left, static_cast<Coord>(0));
+            surface.top     = max(clip.top, static_cast<Coord>(0));
+            surface.right   = min(clip.right, surface.width);
+            surface.bottom  = min(clip.bottom, static_cast<Coord>(ctx->height()));
+            return surface.pixels != nullptr;
+        }
 
-        virtual Rect getClientRect() const noexcept = 0;
+        static Coord _clampRadius(Coord w, Coord h, Coord r) noexcept
+        {
+            return max(static_cast<Coord>(0), min(r, static_cast<Coord>(min(w, h) / 2)));
+        }
 
-        virtual Rect getDirtyRect() const noexcept = 0;
-        virtual void markRectDirty(const Rect&) noexcept = 0;
+        // Replays the libraries' fillCircleHelper(), noting where each of its vertical
+        // lines begins rather than drawing it.
+        static void _getCornerColumns(Coord r, std::array<Coord, MaxRadius + 1>& top) noexcept
+        {
+            top.fill(-1);
+            Coord f     = 1 - r;
+            Coord ddF_x = 1;
+            Coord ddF_y = -2 * r;
+            Coord x     = 0;
+            Coord y     = r;
+            Coord px    = x;
+            Coord py    = y;
+            while (x < y) {
+                if (f >= 0) {
+                    y--;
+                    ddF_y += 2;
+                    f += ddF_y;
+                }
+                x++;
+                ddF_x += 2;
+                f += ddF_x;
+                if (x < (y + 1)) {
+                    top[x] = max(top[x], y);
+                }
+                if (y != py) {
+                    top[py] = max(top[py], px);
+                    py = y;
+                }
+                px = x;
+            }
+        }
+    };
+# endif
 
-        virtual Style getStyle() const noexcept = 0;
-        virtual void setStyle(Style) noexcept = 0;
+    // The following draw by way of Raster where possible, or else the graphics library.
+    inline void gfxFillRect(const GfxContextPtr& ctx, Coord x, Coord y, Coord w, Coord h,
+        Color color)
+    {
+# if !defined(EWM_NORASTER)
+        if (Raster::fillRect(ctx, x, y, w, h, color)) {
+            return;
+        }
+# endif
+        ctx->fillRect(x, y, w, h, toGfxColor(color));
+    }
 
-        virtual WindowID getID() const noexcept = 0;
+    inline void gfxFillRoundRect(const GfxContextPtr& ctx, Coord x, Coord y, Coord w,
+        Coord h, Coord r, Color color)
+    {
+# if !defined(EWM_NORASTER)
+        if (Raster::fillRoundRect(ctx, x, y, w, h, r, color)) {
+            return;
+        }
+# endif
+        ctx->fillRoundRect(x, y, w, h, r, toGfxColor(color));
+    }
 
-        virtual uint8_t getZOrder() const noexcept = 0;
-        virtual void setZOrder(uint8_t) noexcept = 0;
+    inline void gfxDrawRoundRect(const GfxContextPtr& ctx, Coord x, Coord y, Coord w,
+        Coord h, Coord r, Color color)
+    {
+# if !defined(EWM_NORASTER)
+        if (Raster::drawRoundRect(ctx, x, y, w, h, r, color)) {
+            return;
+        }
+# endif
+        ctx->drawRoundRect(x, y, w, h, r, toGfxColor(color));
+    }
 
-        virtual State getState() const noexcept = 0;
-        virtual void setState(State) noexcept = 0;
+    inline void gfxDrawHLine(const GfxContextPtr& ctx, Coord x, Coord y, Coord w, Color color)
+    {
+# if !defined(EWM_NORASTER)
+        if (Raster::drawHLine(ctx, x, y, w, color)) {
+            return;
+        }
+# endif
+        ctx->drawFastHLine(x, y, w, toGfxColor(color));
+    }
 
-        virtual std::string getText() const = 0;
-        virtual void setText(const std::string&) = 0;
+    inline void gfxDrawVLine(const GfxContextPtr& ctx, Coord x, Coord y, Coord h, Color color)
+    {
+# if !defined(EWM_NORASTER)
+        if (Raster::drawVLine(ctx, x, y, h, color)) {
+            return;
+        }
+# endif
+        ctx->drawFastVLine(x, y, h, toGfxColor(color));
+    }
 
-        virtual Color getBgColor() const noexcept = 0;
-        virtual void setBgColor(Color) noexcept = 0;
-        virtual Color getTextColor() const noexcept = 0;
-        virtual void setTextColor(Color) noexcept = 0;
-        virtual Color getFrameColor() const noexcept = 0;
-        virtual void setFrameColor(Color) noexcept = 0;
-        virtual Color getShadowColor() const noexcept = 0;
-        virtual void setShadowColor(Color) noexcept = 0;
+    // Copies the pixels within `rect` of a (non-rotated) graphics context dx,dy pixels
+    // over, clipped to the context; the source and destination may overlap. Returns
+    // false if the context can't be copied within.
+    inline bool gfxCopyRect(const GfxContextPtr& ctx, const Rect& rect, Coord dx, Coord dy)
+    {
+        if (!ctx || ctx->getRotation() != 0) {
+            return false;
+        }
+        auto pixels = getGfxBuffer(ctx);
+        if (pixels == nullptr) {
+            return false;
+        }
+        const int32_t width  = ctx->width();
+        const int32_t height = ctx->height();
+        const int32_t left   = max<int32_t>(max<int32_t>(rect.left, 0), -dx);
+        const int32_t top    = max<int32_t>(max<int32_t>(rect.top, 0), -dy);
+        const int32_t right  = min<int32_t>(min<int32_t>(rect.right, width), width - dx);
+        const int32_t bottom = min<int32_t>(min<int32_t>(rect.bottom, height), height - dy);
+        if (right <= left || bottom <= top) {
+            return true;
+        }
+        const size_t bytes = static_cast<size_t>(right - left) * sizeof(Color);
+        const auto copyRow = [&](int32_t row)
+        {
+            memmove(pixels + ((row + dy) * width) + left + dx, pixels + (row * width) + left,
+                bytes);
+        };
+        // Rows are moved away from the direction of travel first, so that none is
+        // overwritten before it's copied.
+        if (dy > 0) {
+            for (int32_t row = bottom - 1; row >= top; row--) {
+                copyRow(row);
+            }
+        } else {
+            for (int32_t row = top; row < bottom; row++) {
+                copyRow(row);
+            }
+        }
+# if defined(EWM_ADAFRUIT_HEADLESS)
+        ctx->countPixelsDrawn(static_cast<uint32_t>(right - left) * (bottom - top));
+# endif
+        return true;
+    }
 
-        virtual Coord getCornerRadius() const noexcept = 0;
-        virtual void setCornerRadius(Coord) noexcept = 0;
+    inline GFXglyph* getGlyphAtOffset(const GFXfont* font, uint8_t off)
+    {
+# ifdef __AVR__
+        return &((static_cast<GFXglyph*>(pgm_read_pointer(&font->glyph)))[off]);
+# else
+        return font->glyph + off;
+# endif
+    }
+
+    static void getCharBounds(uint8_t ch, uint8_t* cx, uint8_t* cy, uint8_t* xAdv,
+        uint8_t* yAdv, int8_t* xOff, int8_t* yOff, uint8_t textSize = 1,
+        const GFXfont* font = nullptr) noexcept
+    {
+        uint8_t first = font ? pgm_read_byte(&font->first) : 0;
+        bool okCh = font ? ch >= first && ch <= pgm_read_byte(&font->last) : false;
+        auto glyph = okCh ? getGlyphAtOffset(font, ch - first) : nullptr;
+        if (cx) { *cx = textSize * (font ? (okCh ? pgm_read_byte(&glyph->width) : 0) : 6); }
+        if (cy) { *cy = textSize * (font ? (okCh ? pgm_read_byte(&glyph->height) : 0) : 8); }
+        if (xAdv) { *xAdv = textSize * (okCh ? pgm_read_byte(&glyph->xAdvance) : 6); }
+        if (yAdv) { *yAdv = okCh ? pgm_read_byte(&font->yAdvance) : textSize * 8; }
+        if (xOff) { *xOff = okCh ? pgm_read_byte(&glyph->xOffset) : 0; }
+        if (yOff) { *yOff = okCh ? pgm_read_byte(&glyph->yOffset) : 0; }
+    }
+
+    template<typename T>
+    constexpr T operator&(const T& t1, const T& t2)
+    {
+        return static_cast<T>(
+            static_cast<unsigned>(t1) & static_cast<unsigned>(t2)
+        );
+    }
+
+    template<typename T>
+    constexpr T operator|(const T& t1, const T& t2)
+    {
+        return static_cast<T>(
+            static_cast<unsigned>(t1) | static_cast<unsigned>(t2)
+        );
+    }
+
+    template<typename T>
+    T constexpr operator~(const T& t1)
+    {
+        return static_cast<T>(
+            ~static_cast<unsigned>(t1)
+        );
+    }
+
+    template<typename T1, typename T2>
+    inline bool bitsHigh(const T1& bitmask, const T2& bits) noexcept
+    {
+        return (bitmask & bits) == bits;
+    }
+
+    using Mutex     = std::recursive_mutex;
+    using ScopeLock = std::scoped_lock<Mutex>;
+
+# if !defined(EWM_NOMUTEXES) && defined(EWM_SINGLE_TREE_LOCK)
+    inline Mutex& getTreeMutex()
+    {
+        static Mutex treeMtx;
+        return treeMtx;
+    }
+# endif
+
+    /**
+     * String which keeps up to `InlineChars` characters within itself, and only resorts
+     * to the heap for anything longer. A heap buffer is kept for whatever is assigned
+     * afterwards (growing as needed), so text which changes often but stays about the
+     * same length allocates once at most; reserve() sees to that up front.
+     */
+    template<size_t InlineChars>
+    class InlineString
+    {
+    public:
+        static constexpr size_t InlineCapacity = InlineChars;
+
+        InlineString() = default;
+        InlineString(std::string_view str) { assign(str); }
+        InlineString(const InlineString& other) { assign(other.view()); }
+
+        InlineString& operator=(const InlineString& other)
+        {
+            assign(other.view());
+            return *this;
+        }
+
+        InlineString& operator=(std::string_view str)
+        {
+            assign(str);
+            return *this;
+        }
+
+        /** Replaces the contents, and returns false if they were the same already. */
+        bool assign(std::string_view str)
+        {
+            if (str == view()) {
+                return false;
+            }
+            reserve(str.length());
+            const auto length = min(str.length(), capacity());
+            char* buffer = _heap ? _heap.get() : _inline.data();
+            memmove(buffer, str.data(), length);
+            buffer[length] = '\0';
+            _length = length;
+            return true;
+        }
+
+        /** Makes room for `chars` characters (plus a terminator). */
+        void reserve(size_t chars)
+        {
+            if (chars <= capacity()) {
+                return;
+            }
+            std::unique_ptr<char[]> heap(new (std::nothrow) char[chars + 1U]);
+            if (!heap) {
+                EWM_LOG_E("failed to allocate %zu bytes of text", chars + 1U);
+                return;
+            }
+            memcpy(heap.get(), c_str(), _length + 1U);
+            _heap     = std::move(heap);
+            _capacity = chars;
+        }
+
+        const char* c_str() const noexcept { return _heap ? _heap.get() : _inline.data(); }
+        size_t length() const noexcept { return _length; }
+        bool empty() const noexcept { return _length == 0U; }
+        size_t capacity() const noexcept { return _heap ? _capacity : InlineChars; }
+
+        std::string_view view() const noexcept { return std::string_view(c_str(), _length); }
+        operator std::string_view() const noexcept { return view(); }
+
+        friend bool operator==(const InlineString& lhs, std::string_view rhs) noexcept
+        {
+            return lhs.view() == rhs;
+        }
+
+        friend bool operator!=(const InlineString& lhs, std::string_view rhs) noexcept
+        {
+            return lhs.view() != rhs;
+        }
+
+    private:
+        std::array<char, InlineChars + 1U> _inline {};
+        std::unique_ptr<char[]> _heap;
+        size_t _capacity = 0U; // Of _heap.
+        size_t _length   = 0U;
+    };
+
+    /** Text of a window. */
+    using WindowText = InlineString<EWM_WINDOW_TEXT_INLINE>;
+
+    /** Class name and ID of a window (see IWindow::toString()), for logging. */
+    using WindowName = InlineString<47>;
+
+    enum class Message : uint8_t
+    {
+        None     = 0,
+        Create   = 1,
+        Destroy  = 2,
+        Draw     = 3,
+        PostDraw = 4,
+        Input    = 5,
+        Event    = 6,
+        Resize   = 7,
+        Timer    = 8
+    };
+
+    enum class Style : uint32_t
+    {
+        None       = 0,
+        Visible    =  1 << 0,
+        Child      =  1 << 1,
+        Frame      =  1 << 2,
+        Shadow     =  1 << 3,
+        TopLevel   = (1 << 4) | Frame | Shadow,
+        AutoSize   =  1 << 5,
+        FullScreen =  1 << 6,
+        Button     =  1 << 7,
+        Label      =  1 << 8,
+        Prompt     =  (1 << 9) | TopLevel,
+        Progress   =  1 << 10,
+        CheckBox   =  1 << 11
+    };
+
+    enum class State : uint16_t
+    {
+        None     = 0,      /**< Invalid state. */
+        Alive    = 1 << 0, /**< Active (not yet destroyed). */
+        Checked  = 1 << 1, /**< Checked/highlighted item. */
+        Dirty    = 1 << 2, /**< Needs redrawing. */
+        Pressed  = 1 << 3, /**< Pressed (e.g. a button that was just tapped). */
+        Stale    = 1 << 4, /**< Shared frame buffer contents were overwritten. */
+        Composed = 1 << 5, /**< Gfx context is current; flush without redrawing children. */
+        Undrawn  = 1 << 6  /**< Children have yet to redraw some of the dirty rects. */
+    };
+
+    enum class ProgressStyle : uint8_t
+    {
+        Normal        = 1 << 0, /**< Standard linear-fill progress bar. */
+        Indeterminate = 1 << 1  /**< Marquee-style progress bar. */
+    };
+
+    enum class DrawText : uint8_t
+    {
+        Center   = 1 << 0, /**< Horizontal align center. */
+        Single   = 1 << 1, /**< Single line of text. */
+        Clip     = 1 << 2, /**< Text outside the rect will not be drawn. */
+        Ellipsis = 1 << 3  /**< Replace clipped text with '...' */
+    };
+
+    enum class EventType : uint8_t
+    {
+        ChildTapped = 1
+    };
+
+    /**
+     * Touch input delivered to windows. A touch posted with WindowManager::postTouch()
+     * goes to the window it began on, as Press; then, if it travels far enough, Drag
+     * (at most once per frame), Swipe if it was quick about it, and Release. A touch
+     * which doesn't travel is either a Tap upon release, or a LongPress if held long
+     * enough (followed by Release). WindowManager::hitTest() only ever produces Tap.
+     */
+    enum class InputType : uint8_t
+    {
+        None      = 0,
+        Tap       = 1,
+        Press     = 2,
+        Drag      = 3,
+        Release   = 4,
+        LongPress = 5,
+        Swipe     = 6
+    };
+
+    enum class SwipeDirection : uint8_t
+    {
+        None  = 0,
+        Left  = 1,
+        Right = 2,
+        Up    = 3,
+        Down  = 4
+    };
+
+    /** How an animation's value progresses over its duration. */
+    enum class Easing : uint8_t
+    {
+        Linear    = 0,
+        EaseIn    = 1, /**< Quadratic; starts out slow. */
+        EaseOut   = 2, /**< Quadratic; slows down at the end. */
+        EaseInOut = 3  /**< Quadratic; slow at both ends. */
+    };
+
+    struct InputParams
+    {
+# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
+        WindowName handledBy;
+# endif
+        InputType type = InputType::None;
+        Coord x = 0;
+        Coord y = 0;
+        uint8_t pointer = 0U;
+        SwipeDirection direction = SwipeDirection::None; /**< Swipe only. */
+    };
+
+    static MsgParam makeMsgParam(const MsgParamWord& hiWord, const MsgParamWord& loWord)
+    {
+        return (static_cast<MsgParam>(hiWord) << 16) | (loWord & 0xffffU);
+    }
+
+    static MsgParamWord getMsgParamHiWord(const MsgParam& msgParam)
+    {
+        return ((msgParam >> 16) & 0xffffU);
+    }
+
+    static MsgParamWord getMsgParamLoWord(const MsgParam& msgParam)
+    {
+        return (msgParam & 0xffffU);
+    }
+
+    enum class ColorID : uint8_t
+    {
+        Screensaver = 1,
+
+        PromptBg,
+        PromptFrame,
+        PromptShadow,
+
+        WindowText,
+        WindowBg,
+        WindowFrame,
+        WindowShadow,
+
+        ButtonText,
+        ButtonTextPressed,
+        ButtonBg,
+        ButtonBgPressed,
+        ButtonFrame,
+        ButtonFramePressed,
+
+        ProgressBg,
+        ProgressFill,
+
+        CheckBoxCheckBg,
+        CheckBoxCheckFrame,
+        CheckBoxCheck
+    };
+
+    /** One past the highest ColorID. */
+    static constexpr size_t ColorIDEnd = static_cast<size_t>(ColorID::CheckBoxCheck) + 1U;
+
+    enum class MetricID : uint8_t
+    {
+        XPadding = 1,             /**< Extent */
+        YPadding,                 /**< Extent */
+
+        DefTextSize,              /**< uint8_t */
+
+        WindowFramePx,            /**< Extent */
+        CornerRadiusWindow,       /**< Coord */
+        CornerRadiusButton,       /**< Coord */
+        CornerRadiusPrompt,       /**< Coord */
+        CornerRadiusCheckBox,     /**< Coord */
+
+        DefButtonCX,              /**< Extent */
+        DefButtonCY,              /**< Extent */
+        ButtonLabelPadding,       /**< Extent */
+        ButtonTappedDuration,     /**< uint32_t */
+
+        MaxPromptCX,              /**< Extent */
+        MaxPromptCY,              /**< Extent */
+
+        DefProgressHeight,        /**< Extent */
+        ProgressMarqueeCXFactor,  /**< float */
+        ProgressMarqueeStep,      /**< float */
+
+        DefCheckBoxHeight,        /**< Extent */
+        CheckBoxCheckAreaPadding, /**< Extent */
+        CheckBoxCheckMarkPadding, /**< Extent */
+        CheckBoxCheckDelay        /**< uint32_t */
+    };
+
+    /** One past the highest MetricID. */
+    static constexpr size_t MetricIDEnd = static_cast<size_t>(MetricID::CheckBoxCheckDelay) + 1U;
+
+    struct Variant
+    {
+        enum class Type : uint8_t
+        {
+            Empty  = 0,
+            Extent = 1,
+            Coord  = 2,
+            UInt8  = 3,
+            UInt32 = 4,
+            Float  = 5
+        };
+
+        Variant() = default;
+
+        Type getType() const noexcept { return _type; }
+
+        Extent getExtent() const noexcept
+        {
+            EWM_ASSERT(_type == Type::Extent);
+            return _extentValue;
+        }
+
+        void setExtent(const Extent& extent) noexcept
+        {
+            _extentValue = extent;
+            _type = Type::Extent;
+        }
+
+        Coord getCoord() const noexcept
+        {
+            EWM_ASSERT(_type == Type::Coord);
+            return _coordValue;
+        }
+
+        void setCoord(const Coord& coord) noexcept
+        {
+            _coordValue = coord;
+            _type = Type::Coord;
+        }
+
+        uint8_t getUint8() const noexcept
+        {
+            EWM_ASSERT(_type == Type::UInt8);
+            return _uint8Value;
+        }
+
+        void setUint8(const uint8_t& octet) noexcept
+        {
+            _uint8Value = octet;
+            _type = Type::UInt8;
+        }
+
+        uint32_t getUint32() const noexcept
+        {
+            EWM_ASSERT(_type == Type::UInt32);
+            return _uint32Value;
+        }
+
+        void setUint32(const uint32_t& dword) noexcept
+        {
+            _uint32Value = dword;
+            _type = Type::UInt32;
+        }
+
+        float getFloat() const noexcept
+        {
+            EWM_ASSERT(_type == Type::Float);
+            return _floatValue;
+        }
+
+        void setFloat(const float& flt) noexcept
+        {
+            _floatValue = flt;
+            _type = Type::Float;
+        }
+
+    private:
+        union
+        {
+            Extent _extentValue;
+            Coord _coordValue;
+            uint8_t _uint8Value;
+            uint32_t _uint32Value;
+            float _floatValue = 0.0f;
+        };
+        Type _type = Type::Empty;
+    };
+
+    /**
+     * Least-recently-used cache of text layouts, keyed by everything that has an
+     * effect on where each glyph of a string ends up.
+     */
+    class TextLayoutCache
+    {
+    public:
+        static constexpr size_t Capacity = EWM_TEXT_LAYOUT_CACHE;
+
+        struct Glyph
+        {
+            Coord x = 0;
+            Coord y = 0;
+            char ch = '\0';
+        };
+
+        using Glyphs = std::vector<Glyph>;
+
+        struct Key
+        {
+            const char* text     = nullptr;
+            const Font* font     = nullptr;
+            Rect rect;
+            Extent ctxWidth      = 0;
+            DrawText flags       = static_cast<DrawText>(0);
+            uint8_t textSize     = 0;
+        };
+
+        /** Returns the cached layout matching the key, or nullptr. */
+        const Glyphs* find(const Key& key) noexcept
+        {
+            for (auto& entry : _entries) {
+                if (entry.used && _matches(entry, key)) {
+                    entry.lastUsed = ++_clock;
+                    return &entry.glyphs;
+                }
+            }
+            return nullptr;
+        }
+
+        /** Evicts the least recently used layout, and returns its (empty) glyphs to fill. */
+        Glyphs& insert(const Key& key)
+        {
+            if (Capacity == 0U) {
+                _scratch.clear();
+                return _scratch;
+            }
+            auto victim = _entries.begin();
+            for (auto it = _entries.begin(); it != _entries.end(); it++) {
+                if (!it->used) {
+                    victim = it;
+                    break;
+                }
+                if (it->lastUsed < victim->lastUsed) {
+                    victim = it;
+                }
+            }
+            victim->text     = key.text;
+            victim->font     = key.font;
+            victim->rect     = key.rect;
+            victim->ctxWidth = key.ctxWidth;
+            victim->flags    = key.flags;
+            victim->textSize = key.textSize;
+            victim->lastUsed = ++_clock;
+            victim->used     = true;
+            victim->glyphs.clear();
+            return victim->glyphs;
+        }
+
+        void clear() noexcept
+        {
+            for (auto& entry : _entries) {
+                entry.used = false;
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            WindowText text;
+            const Font* font  = nullptr;
+            Rect rect;
+            Extent ctxWidth   = 0;
+            DrawText flags    = static_cast<DrawText>(0);
+            uint8_t textSize  = 0;
+            uint32_t lastUsed = 0U;
+            bool used         = false;
+            Glyphs glyphs;
+        };
+
+        static bool _matches(const Entry& entry, const Key& key) noexcept
+        {
+            return entry.font == key.font && entry.rect == key.rect &&
+                   entry.ctxWidth == key.ctxWidth && entry.flags == key.flags &&
+                   entry.textSize == key.textSize && entry.text == key.text;
+        }
+
+        std::array<Entry, Capacity> _entries;
+        Glyphs _scratch;
+        uint32_t _clock = 0U;
+    };
+
+# if defined(EWM_GLYPH_ATLAS)
+    /**
+     * Glyphs of custom fonts, pre-rasterized into runs of set pixels per row. Since
+     * text is always drawn with a transparent background, runs are independent of
+     * color, and are drawn as fast horizontal lines (or filled rects, when scaled).
+     */
+    class GlyphAtlas
+    {
+    public:
+        /** Returns false if the character must be drawn by the graphics library. */
+        bool drawChar(const GfxContextPtr& ctx, const Font* font, uint8_t ch, Coord x,
+            Coord y, uint8_t textSize, Color color)
+        {
+            if (font == nullptr) {
+                return false;
+            }
+            const auto first = pgm_read_byte(&font->first);
+            if (ch < first || ch > pgm_read_byte(&font->last)) {
+                return false;
+            }
+            const auto& spans = _getSpans(font);
+            const auto idx    = ch - first;
+            for (auto span = spans.offsets[idx]; span < spans.offsets[idx + 1U]; span++) {
+                const auto& run = spans.runs[span];
+                if (textSize == 1U) {
+                    gfxDrawHLine(ctx, x + run.x, y + run.y, run.length, color);
+                } else {
+                    gfxFillRect(ctx, x + (run.x * textSize), y + (run.y * textSize),
+                        run.length * textSize, textSize, color);
+                }
+            }
+            return true;
+        }
+
+    private:
+        struct Run
+        {
+            int16_t x      = 0; /**< Relative to the glyph's origin, including its X offset. */
+            int16_t y      = 0; /**< Relative to the glyph's origin, including its Y offset. */
+            uint8_t length = 0;
+        };
+
+        struct FontSpans
+        {
+            const Font* font = nullptr;
+            std::vector<uint16_t> offsets; /**< Index of each glyph's first run (+ end). */
+            std::vector<Run> runs;
+        };
+
+        const FontSpans& _getSpans(const Font* font)
+        {
+            for (const auto& spans : _fonts) {
+                if (spans.font == font) {
+                    return spans;
+                }
+            }
+            FontSpans spans;
+            spans.font = font;
+            const auto first  = pgm_read_byte(&font->first);
+            const auto last   = pgm_read_byte(&font->last);
+# ifdef __AVR__
+            const auto bitmap = static_cast<const uint8_t*>(pgm_read_pointer(&font->bitmap));
+# else
+            const auto bitmap = font->bitmap;
+# endif
+            for (uint16_t ch = first; ch <= last; ch++) {
+                spans.offsets.push_back(static_cast<uint16_t>(spans.runs.size()));
+                const auto glyph    = getGlyphAtOffset(font, ch - first);
+                const auto width    = pgm_read_byte(&glyph->width);
+                const auto height   = pgm_read_byte(&glyph->height);
+                const int8_t xOff   = pgm_read_byte(&glyph->xOffset);
+                const int8_t yOff   = pgm_read_byte(&glyph->yOffset);
+                uint16_t offset     = pgm_read_word(&glyph->bitmapOffset);
+                uint8_t bits        = 0;
+                uint8_t bit         = 0;
+                // Bits are packed row after row, most significant first, exactly as
+                // the graphics libraries walk them in drawChar().
+                for (uint8_t row = 0; row < height; row++) {
+                    Run run;
+                    for (uint8_t col = 0; col < width; col++) {
+                        if ((bit++ & 7U) == 0U) {
+                            bits = pgm_read_byte(&bitmap[offset++]);
+                        }
+                        const bool set = (bits & 0x80U) != 0U;
+                        bits <<= 1;
+                        if (set) {
+                            if (run.length == 0U) {
+                                run.x = xOff + col;
+                                run.y = yOff + row;
+                            }
+                            run.length++;
+                        } else if (run.length > 0U) {
+                            spans.runs.push_back(run);
+                            run.length = 0U;
+                        }
+                    }
+                    if (run.length > 0U) {
+                        spans.runs.push_back(run);
+                    }
+                }
+            }
+            spans.offsets.push_back(static_cast<uint16_t>(spans.runs.size()));
+            EWM_LOG_V("rasterized %u glyphs into %zu runs", (last - first) + 1U,
+                spans.runs.size());
+            _fonts.push_back(std::move(spans));
+            return _fonts.back();
+        }
+
+        std::deque<FontSpans> _fonts;
+    };
+# endif
+
+    class ITheme
+    {
+    public:
+        enum class DisplaySize : uint8_t
+        {
+            Small = 0,
+            Medium,
+            Large
+        };
+
+        virtual void setDisplayExtents(Extent, Extent) = 0;
+
+        virtual Color getColor(ColorID) const = 0;
+        virtual Variant getMetric(MetricID) const = 0;
+
+        virtual void drawScreensaver(const GfxDisplayPtr&) const = 0;
+
+        virtual void setDefaultFont(const Font*) = 0;
+        virtual const Font* getDefaultFont() const = 0;
+
+        virtual DisplaySize getDisplaySize() const = 0;
+        virtual Extent getScaledValue(Extent) const = 0;
+
+        virtual void drawWindowFrame(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
+        virtual void drawWindowShadow(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
+        virtual void drawWindowBackground(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
+        virtual void drawText(const GfxContextPtr&, const char*, DrawText, const Rect&,
+            uint8_t, Color, const Font*) const = 0;
+
+        virtual void drawProgressBarBackground(const GfxContextPtr&, const Rect&) const = 0;
+        virtual void drawProgressBarProgress(const GfxContextPtr&, const Rect&, float) const = 0;
+        virtual void drawProgressBarIndeterminate(const GfxContextPtr&, const Rect&, float, Coord&) const = 0;
+        virtual void drawProgressBarFill(const GfxContextPtr&, const Rect&) const = 0;
+
+        // The part of a progress bar's rect that is filled, for the given value (and,
+        // for the marquee, the bar's step counter, which starts out at -1).
+        virtual Rect getProgressBarProgressRect(const Rect&, float) const = 0;
+        virtual Rect getProgressBarMarqueeRect(const Rect&, float, Coord&) const = 0;
+
+        virtual void drawCheckBox(const GfxContextPtr&, const char*, bool, const Rect&) const = 0;
+    };
+
+    using ThemePtr = std::shared_ptr<ITheme>;
+
+    class DefaultTheme : public ITheme
+    {
+    public:
+        DefaultTheme() = default;
+
+        void setDisplayExtents(Extent width, Extent height) final
+        {
+            _displayWidth  = width;
+            _displayHeight = height;
+            // Padding metrics scale with the display, and so do text layouts.
+            _resolveScale();
+            _resolved = false;
+            _layoutCache.clear();
+        }
+
+        Color getColor(ColorID colorID) const final
+        {
+            _resolveIfNeeded();
+            const auto idx = static_cast<size_t>(colorID);
+            EWM_ASSERT(idx > 0U && idx < _colors.size());
+            return idx < _colors.size() ? _colors[idx] : Color(0);
+        }
+
+        Variant getMetric(MetricID metricID) const final
+        {
+            _resolveIfNeeded();
+            const auto idx = static_cast<size_t>(metricID);
+            EWM_ASSERT(idx > 0U && idx < _metrics.size());
+            return idx < _metrics.size() ? _metrics[idx] : Variant();
+        }
+
+        void drawScreensaver(const GfxDisplayPtr& display) const final
+        {
+            EWM_ASSERT(display);
+            display->fillScreen(toGfxColor(getColor(ColorID::Screensaver)));
+        }
+
+        void setDefaultFont(const Font* font) final
+        {
+            _defaultFont = font;
+        }
+
+        const Font* getDefaultFont() const final { return _defaultFont; }
+
+        DisplaySize getDisplaySize() const final { return _displaySize; }
+
+        Extent getScaledValue(Extent value) const final
+        {
+            return static_cast<Extent>(value * _scale);
+        }
+
+    protected:
+        // The theme's colors and metrics, resolved upon the first getColor() or
+        // getMetric() after construction or setDisplayExtents(), which then merely look
+        // them up. Derived themes may override these in order to customize them. (Not
+        // from the constructor, where these calls wouldn't reach the overrides.)
+        virtual Color resolveColor(ColorID colorID) const
+        {
+            switch (colorID) {
+                case ColorID::Screensaver:        return colorFrom565(0x0000);
+                case ColorID::PromptBg:           return colorFrom565(0xef5c);
+                case ColorID::PromptFrame:        return colorFrom565(0x9cf3);
+                case ColorID::PromptShadow:       return colorFrom565(0xb5b6);
+                case ColorID::WindowText:         return colorFrom565(0x0000);
+                case ColorID::WindowBg:           return colorFrom565(0xdedb);
+                case ColorID::WindowFrame:        return colorFrom565(0x9cf3);
+                case ColorID::WindowShadow:       return colorFrom565(0xb5b6);
+                case ColorID::ButtonText:         return colorFrom565(0xffff);
+                case ColorID::ButtonTextPressed:  return colorFrom565(0xffff);
+                case ColorID::ButtonBg:           return colorFrom565(0x8c71);
+                case ColorID::ButtonBgPressed:    return colorFrom565(0x738e);
+                case ColorID::ButtonFrame:        return colorFrom565(0x6b6d);
+                case ColorID::ButtonFramePressed: return colorFrom565(0x6b6d);
+                case ColorID::ProgressBg:         return colorFrom565(0xef5d);
+                case ColorID::ProgressFill:       return colorFrom565(0x0ce0);
+                case ColorID::CheckBoxCheckBg:    return colorFrom565(0xef5d);
+                case ColorID::CheckBoxCheck:      return colorFrom565(0x3166);
+                case ColorID::CheckBoxCheckFrame: return colorFrom565(0x9cf3);
+                default:
+                    EWM_ASSERT("!invalid color ID");
+                    return Color(0);
+            }
+        }
+
+        virtual Variant resolveMetric(MetricID metricID) const
+        {
+            Variant retval;
+            switch (metricID) {
+                case MetricID::XPadding:
+                    retval.setExtent(abs(_displayWidth * 0.05f));
+                break;
+                case MetricID::YPadding:
+                    retval.setExtent(abs(_displayHeight * 0.05f));
+                break;
+                case MetricID::DefTextSize:
+                    retval.setUint8(1);
+                break;
+                case MetricID::WindowFramePx:
+                    retval.setExtent(1);
+                break;
+                case MetricID::CornerRadiusWindow:
+                    retval.setCoord(0);
+                break;
+                case MetricID::CornerRadiusButton:
+                    retval.setCoord(getScaledValue(4));
+                break;
+                case MetricID::CornerRadiusPrompt:
+                    retval.setCoord(getScaledValue(4));
+                break;
+                case MetricID::CornerRadiusCheckBox:
+                    retval.setCoord(getScaledValue(0));
+                break;
+                case MetricID::DefButtonCX:
+                    retval.setExtent(abs(max(_displayWidth * 0.19f, 60.0f)));
+                break;
+                case MetricID::DefButtonCY: {
+                    const auto btnWidth = resolveMetric(MetricID::DefButtonCX).getExtent();
+                    retval.setExtent(abs(btnWidth * 0.52f));
+                }
+                break;
+                case MetricID::ButtonLabelPadding:
+                    retval.setExtent(getScaledValue(10));
+                break;
+                case MetricID::ButtonTappedDuration:
+                    retval.setUint32(200);
+                break;
+                case MetricID::MaxPromptCX:
+                    retval.setExtent(abs(_displayWidth * 0.75f));
+                break;
+                case MetricID::MaxPromptCY:
+                    retval.setExtent(abs(_displayHeight * 0.75f));
+                break;
+                case MetricID::DefProgressHeight:
+                    retval.setExtent(abs(_displayHeight * 0.10f));
+                break;
+                case MetricID::ProgressMarqueeCXFactor:
+                    retval.setFloat(0.33f);
+                break;
+                case MetricID::ProgressMarqueeStep: {
+                    static constexpr float step = 1.0f;
+                    switch (getDisplaySize()) {
+                        case DisplaySize::Small:
+                            retval.setFloat(step);
+                        break;
+                        case DisplaySize::Medium:
+                            retval.setFloat(step * 2.0f);
+                        break;
+                        case DisplaySize::Large:
+                            retval.setFloat(step * 4.0f);
+                        break;
+                        default:
+                            EWM_ASSERT(!"invalid display size");
+                            retval.setFloat(step);
+                        break;
+                    }
+                }
+                break;
+                case MetricID::DefCheckBoxHeight:
+                    retval.setExtent(abs(_displayHeight * 0.10f));
+                break;
+                case MetricID::CheckBoxCheckAreaPadding:
+                    retval.setExtent(getScaledValue(2));
+                break;
+                case MetricID::CheckBoxCheckMarkPadding:
+                    retval.setExtent(getScaledValue(2));
+                break;
+                case MetricID::CheckBoxCheckDelay:
+                    retval.setUint32(200);
+                break;
+                default:
+                    EWM_ASSERT(!"invalid metric ID");
+                break;
+            }
+            return retval;
+        }
+
+    public:
+
+        void drawWindowFrame(const GfxContextPtr& ctx, const Rect& rect,
+            Coord radius, Color color) const final
+        {
+            auto tmp = rect;
+            auto pixels = getMetric(MetricID::WindowFramePx).getExtent();
+            while (pixels-- > 0) {
+                EWM_ASSERT(ctx);
+                gfxDrawRoundRect(ctx, tmp.left, tmp.top, tmp.width(), tmp.height(), radius, color);
+                tmp.deflate(1);
+            }
+        }
+
+        void drawWindowShadow(const GfxContextPtr& ctx, const Rect& rect,
+            Coord radius, Color color) const final
+        {
+            EWM_ASSERT(ctx);
+            const auto thickness = getMetric(MetricID::WindowFramePx).getExtent();
+            // One line along the bottom edge and one down the right, both inclusive of
+            // their end points.
+            const Coord hBegin = rect.left + radius + thickness;
+            const Coord hEnd   = rect.left + (rect.width() - (radius + (thickness * 2)));
+            const Coord vBegin = rect.top + radius + thickness;
+            const Coord vEnd   = rect.top + (rect.height() - (radius + (thickness * 2)));
+            gfxDrawHLine(ctx, min(hBegin, hEnd), rect.bottom, abs(hEnd - hBegin) + 1, color);
+            gfxDrawVLine(ctx, rect.right, min(vBegin, vEnd), abs(vEnd - vBegin) + 1, color);
+        }
+
+        void drawWindowBackground(const GfxContextPtr& ctx, const Rect& rect,
+            Coord radius, Color color) const final
+        {
+            EWM_ASSERT(ctx);
+            gfxFillRoundRect(ctx, rect.left, rect.top, rect.width(), rect.height(),
+                radius, color);
+        }
+
+        void drawText(const GfxContextPtr& ctx, const char* text, DrawText flags,
+            const Rect& rect, uint8_t textSize, Color textColor, const Font* font) const final
+        {
+            EWM_ASSERT(ctx);
+            ctx->setTextSize(textSize);
+            ctx->setFont(font);
+
+            TextLayoutCache::Key key;
+            key.text     = text;
+            key.font     = font;
+            key.rect     = rect;
+            key.ctxWidth = ctx->width();
+            key.flags    = flags;
+            key.textSize = textSize;
+            auto glyphs = _layoutCache.find(key);
+            if (glyphs == nullptr) {
+                auto& layout = _layoutCache.insert(key);
+                layoutText(ctx, text, flags, rect, textSize, font, layout);
+                glyphs = &layout;
+            }
+            const bool clipped = ctx->hasClipRect();
+            for (const auto& glyph : *glyphs) {
+                if (clipped) {
+                    // Skip glyphs that would be clipped away entirely.
+                    uint8_t cx  = 0;
+                    uint8_t cy  = 0;
+                    int8_t xOff = 0;
+                    int8_t yOff = 0;
+                    getCharBounds(glyph.ch, &cx, &cy, nullptr, nullptr, &xOff, &yOff, 1U, font);
+                    if (!ctx->intersectsClipRect(glyph.x + (xOff * textSize),
+                        glyph.y + (yOff * textSize), cx * textSize, cy * textSize)) {
+                        continue;
+                    }
+                }
+# if defined(EWM_GLYPH_ATLAS)
+                if (_glyphAtlas.drawChar(ctx, font, glyph.ch, glyph.x, glyph.y, textSize,
+                    textColor)) {
+                    continue;
+                }
+# endif
+                ctx->drawChar(
+                    glyph.x,
+                    glyph.y,
+                    glyph.ch,
+                    toGfxColor(textColor),
+                    toGfxColor(textColor)
+# if defined(EWM_GFX_ADAFRUIT)
+                    , textSize
+# endif
+                );
+            }
+        }
+
+        /**
+         * Computes the position of each glyph drawText() would draw, in the order it
+         * would draw them. The text size and font must already be set on `ctx`.
+         */
+        void layoutText(const GfxContextPtr& ctx, const char* text, DrawText flags,
+            const Rect& rect, uint8_t textSize, const Font* font,
+            TextLayoutCache::Glyphs& glyphs) const
+        {
+            EWM_ASSERT(ctx);
+            const bool xCenter = bitsHigh(flags, DrawText::Center);
+            const bool singleLine = bitsHigh(flags, DrawText::Single);
+            uint8_t xAdv    = 0;
+            uint8_t yAdv    = 0;
+            uint8_t yAdvMax = 0;
+            int8_t xOff     = 0;
+            int8_t yOff     = 0;
+            int8_t yOffMin  = 0;
+            Extent xAccum   = 0;
+            Extent yAccum   = 0;
+            if (singleLine) {
+                int16_t x  = 0;
+                int16_t y  = rect.top + (rect.height() / 2);
+                uint16_t w = 0;
+                uint16_t h = 0;
+                ctx->getTextBounds(text, rect.left, y, &x, &y, &w, &h);
+                yAccum = rect.top + (rect.height() / 2) + (h / 2) - 1;
+            } else {
+                yAccum = rect.top + getMetric(MetricID::YPadding).getExtent();
+            }
+
+            const Extent xPadding =
+                ((singleLine && !xCenter) ? 0 : getMetric(MetricID::XPadding).getExtent());
+            const Extent xExtent = rect.right - xPadding;
+            const char* cursor = text;
+
+            while (*cursor != '\0') {
+                xAccum = rect.left + xPadding;
+                const char* old_cursor = cursor;
+                _charXAdvs.clear();
+                bool clipped = false;
+                while (xAccum <= xExtent && *cursor != '\0') {
+                    /// TODO: handle \n and \r
+                    getCharBounds(*cursor, nullptr, nullptr, &xAdv, &yAdv, &xOff,
+                        &yOff, textSize, font);
+                    if (xAccum + xAdv > xExtent) {
+                        if (singleLine && bitsHigh(flags, DrawText::Clip)) {
+                            clipped = true;
+                            break;
+                        }
+                        if (singleLine && bitsHigh(flags, DrawText::Ellipsis)) {
+                            auto it = _charXAdvs.rbegin();
+                            if (it != _charXAdvs.rend()) {
+                                clipped = true;
+                                xAccum -= (*it);
+                                _charXAdvs.pop_back();
+                                cursor--;
+                                break;
+                            }
+                        }
+                    }
+                    _charXAdvs.push_back(xAdv);
+                    xAccum += xAdv;
+                    cursor++;
+                    if (yAdv > yAdvMax) { yAdvMax = yAdv; }
+                    if (yOff > yOffMin) { yOffMin = yOff; }
+                }
+                if (!singleLine && cursor == old_cursor) {
+                    // Not even one character fits on a line.
+                    break;
+                }
+                size_t rewound = 0;
+                // Wrap at the last space, unless the rest of the text fit on this line.
+                if (!singleLine && (*cursor != '\0' || xAccum > xExtent)) {
+                    for (size_t rewind = 0; rewind < static_cast<size_t>(cursor - old_cursor); rewind++) {
+                        if (*(cursor - rewind) == ' ') {
+                            rewound = rewind;
+                            cursor -= rewind;
+                            while (rewind > 0) {
+                                xAccum -= _charXAdvs.at(_charXAdvs.size() - rewind);
+                                rewind--;
+                            }
+                            break;
+                        }
+                    }
+                }
+                const Extent drawnWidth = xAccum - (rect.left + xPadding);
+                xAccum = xCenter
+                    ? rect.left + (rect.width() / 2) - (drawnWidth / 2)
+                    : rect.left + xPadding;
+                while (old_cursor < cursor) {
+                    glyphs.push_back({
+                        static_cast<Coord>(xAccum), static_cast<Coord>(yAccum), *old_cursor++
+                    });
+                    xAccum += _charXAdvs[
+                        _charXAdvs.size() - 2 - ((cursor + rewound) - old_cursor - 1)
+                    ];
+                }
+                if (!singleLine) {
+                    if (rewound > 0) { cursor++; }
+                    yAccum += yAdvMax + yOffMin;
+                } else {
+                    if (clipped && bitsHigh(flags, DrawText::Ellipsis)) {
+                        getCharBounds('.', nullptr, nullptr, &xAdv, &yAdv,
+                            &xOff, &yOff, textSize, font);
+                        for (uint8_t ellipsis = 0; ellipsis < 3; ellipsis++) {
+                            glyphs.push_back({
+                                static_cast<Coord>(xAccum), static_cast<Coord>(yAccum), '.'
+                            });
+                            xAccum += xAdv;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+
+        void drawProgressBarBackground(const GfxContextPtr& ctx, const Rect& rect) const final
+        {
+            EWM_ASSERT(ctx);
+            gfxFillRect(ctx, rect.left, rect.top, rect.width(), rect.height(),
+                getColor(ColorID::ProgressBg));
+        }
+
+        void drawProgressBarProgress(const GfxContextPtr& ctx, const Rect& rect, float percent) const final
+        {
+            drawProgressBarFill(ctx, getProgressBarProgressRect(rect, percent));
+        }
+
+        // `step` is the caller's marquee state (see getProgressBarMarqueeRect()).
+        void drawProgressBarIndeterminate(const GfxContextPtr& ctx, const Rect& rect, float counter,
+            Coord& step) const final
+        {
+            drawProgressBarFill(ctx, getProgressBarMarqueeRect(rect, counter, step));
+        }
+
+        void drawProgressBarFill(const GfxContextPtr& ctx, const Rect& fillRect) const final
+        {
+            EWM_ASSERT(ctx);
+            gfxFillRect(ctx, fillRect.left, fillRect.top, fillRect.width(),
+                fillRect.height(), getColor(ColorID::ProgressFill));
+        }
+
+        Rect getProgressBarProgressRect(const Rect& rect, float percent) const final
+        {
+            EWM_ASSERT(percent >= 0.0f && percent <= 100.0f);
+            auto barRect = rect;
+            barRect.deflate(getMetric(MetricID::WindowFramePx).getExtent() * 2);
+            barRect.right = barRect.left + abs(barRect.width() * (min(100.0f, percent) / 100.0f));
+            return barRect;
+        }
+
+        Rect getProgressBarMarqueeRect(const Rect& rect, float counter, Coord& step) const final
+        {
+            EWM_ASSERT(counter >= 0.0f && counter <= 100.0f);
+            auto barRect = rect;
+            barRect.deflate(getMetric(MetricID::WindowFramePx).getExtent() * 2);
+            Extent marqueeWidth
+                = (barRect.width() * getMetric(MetricID::ProgressMarqueeCXFactor).getFloat());
+            Coord offset
+                = (barRect.width() + marqueeWidth) * (min(100.0f, counter) / 100.0f);
+            Coord& reverseOffset = step;
+            if (reverseOffset < 0) {
+                reverseOffset = marqueeWidth;
+            }
+            Coord x = 0;
+            Extent width = 0;
+            if (offset < marqueeWidth) {
+                x = barRect.left;
+                if (counter <= __FLT_EPSILON__) {
+                    reverseOffset = marqueeWidth;
+                }
+                width = offset;
+            } else {
+                Coord realOffset = reverseOffset > 0
+                    ? offset - reverseOffset--
+                    : offset;
+                x = min(
+                    static_cast<Coord>(barRect.left + realOffset),
+                    barRect.right
+                );
+                width = min(
+                    marqueeWidth,
+                    static_cast<Extent>(barRect.right - x)
+                );
+            }
+            return Rect(x, barRect.top, x + width, barRect.bottom);
+        }
+
+        void drawCheckBox(const GfxContextPtr& ctx, const char* lbl, bool checked, const Rect& rect) const final
+        {
+            const auto radius = getMetric(MetricID::CornerRadiusCheckBox).getCoord();
+            drawWindowBackground(ctx, rect, radius, getColor(ColorID::WindowBg));
+            auto checkableRect = Rect(
+                rect.left,
+                rect.top + getMetric(MetricID::CheckBoxCheckAreaPadding).getExtent(),
+                rect.left + (rect.height() - (getMetric(MetricID::CheckBoxCheckAreaPadding).getExtent() * 2)),
+                rect.top + (rect.height() - getMetric(MetricID::CheckBoxCheckAreaPadding).getExtent())
+            );
+            checkableRect.top = rect.top + ((rect.height() / 2) - (checkableRect.height() / 2));
+            EWM_ASSERT(ctx);
+            gfxFillRoundRect(
+                ctx,
+                checkableRect.left,
+                checkableRect.top,
+                checkableRect.width(),
+                checkableRect.height(),
+                radius,
+                getColor(ColorID::CheckBoxCheckBg)
+            );
+            drawWindowFrame(ctx, checkableRect, radius, getColor(ColorID::CheckBoxCheckFrame));
+            if (checked) {
+                auto rectCheckMark = checkableRect;
+                rectCheckMark.deflate(getMetric(MetricID::CheckBoxCheckMarkPadding).getExtent());
+                gfxFillRoundRect(
+                    ctx,
+                    rectCheckMark.left,
+                    rectCheckMark.top,
+                    rectCheckMark.width(),
+                    rectCheckMark.height(),
+                    radius,
+                    getColor(ColorID::CheckBoxCheck)
+                );
+            }
+            Rect textRect(
+                checkableRect.right + (getMetric(MetricID::CheckBoxCheckMarkPadding).getExtent() * 2),
+                rect.top,
+                checkableRect.right + (rect.width() - checkableRect.width()),
+                rect.top + rect.height()
+            );
+            drawText(
+                ctx,
+                lbl,
+                DrawText::Single | DrawText::Ellipsis,
+                textRect,
+                getMetric(MetricID::DefTextSize).getUint8(),
+                getColor(ColorID::WindowText),
+                getDefaultFont()
+            );
+        }
+
+    private:
+        void _resolveScale() noexcept
+        {
+            if (_displayWidth <= 320 && _displayHeight <= 320) {
+                _displaySize = DisplaySize::Small;
+                _scale       = 1U;
+            } else if (_displayWidth <= 480 && _displayHeight <= 480) {
+                _displaySize = DisplaySize::Medium;
+                _scale       = 2U;
+            } else {
+                _displaySize = DisplaySize::Large;
+                _scale       = 3U;
+            }
+        }
+
+        void _resolveIfNeeded() const
+        {
+            if (_resolved) {
+                return;
+            }
+            // Set first, in case an override looks up another color or metric.
+            _resolved = true;
+            for (size_t idx = 1U; idx < _colors.size(); idx++) {
+                _colors[idx] = resolveColor(static_cast<ColorID>(idx));
+            }
+            for (size_t idx = 1U; idx < _metrics.size(); idx++) {
+                _metrics[idx] = resolveMetric(static_cast<MetricID>(idx));
+            }
+        }
+
+        Extent _displayWidth     = 0;
+        Extent _displayHeight    = 0;
+        DisplaySize _displaySize = DisplaySize::Small;
+        Extent _scale            = 1U;
+        mutable std::array<Color, ColorIDEnd> _colors {};
+        mutable std::array<Variant, MetricIDEnd> _metrics {};
+        mutable bool _resolved = false;
+        const Font* _defaultFont = nullptr;
+        mutable TextLayoutCache _layoutCache;
+        mutable std::vector<uint8_t> _charXAdvs;
+# if defined(EWM_GLYPH_ATLAS)
+        mutable GlyphAtlas _glyphAtlas;
+# endif
+    };
+
+    struct PackagedMessage
+    {
+        Message msg = Message::None;
+        MsgParam p1 = 0;
+        MsgParam p2 = 0;
+    };
+
+    // Fixed-capacity FIFO stored inline (no heap allocation); not thread-safe.
+    template<typename T, size_t N>
+    class InlineQueue
+    {
+    public:
+        static_assert(N > 0U);
+
+        bool empty() const noexcept { return _size == 0U; }
+        bool full() const noexcept { return _size == N; }
+        size_t size() const noexcept { return _size; }
+        static constexpr size_t capacity() noexcept { return N; }
+
+        bool push(const T& value) noexcept
+        {
+            if (full()) {
+                return false;
+            }
+            _items[(_head + _size) % N] = value;
+            _size++;
+            return true;
+        }
+
+        bool pop(T& value) noexcept
+        {
+            if (empty()) {
+                return false;
+            }
+            value = _items[_head];
+            _head = (_head + 1U) % N;
+            _size--;
+            return true;
+        }
+
+        // Returns the first queued item for which `pred` returns true, or nullptr.
+        template<typename TPred>
+        T* find(TPred pred) noexcept
+        {
+            for (size_t i = 0U; i < _size; i++) {
+                auto& item = _items[(_head + i) % N];
+                if (pred(item)) {
+                    return &item;
+                }
+            }
+            return nullptr;
+        }
+
+    private:
+        std::array<T, N> _items {};
+        size_t _head = 0U;
+        size_t _size = 0U;
+    };
+
+    using PackagedMessageQueue = InlineQueue<PackagedMessage, EWM_WINDOW_QUEUE_LEN>;
+
+    // Fixed-capacity, lock-free FIFO which any number of tasks may push() to, and one
+    // task pop() from (after D. Vyukov's bounded queue: each cell's sequence number
+    // says whether it is free for the next producer or holds a value for the consumer).
+    // push() fails rather than waits when the ring is full.
+    template<typename T, size_t N>
+    class MessageRing
+    {
+    public:
+        static_assert(N >= 2U && (N & (N - 1U)) == 0U, "capacity must be a power of two");
+
+        MessageRing() noexcept
+        {
+            for (size_t i = 0U; i < N; i++) {
+                _cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        MessageRing(const MessageRing&) = delete;
+        MessageRing& operator=(const MessageRing&) = delete;
+
+        static constexpr size_t capacity() noexcept { return N; }
+
+        bool push(const T& value) noexcept
+        {
+            auto pos = _tail.load(std::memory_order_relaxed);
+            for (;;) {
+                auto& cell = _cells[pos & (N - 1U)];
+                const auto seq  = cell.seq.load(std::memory_order_acquire);
+                const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (_tail.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed)) {
+                        cell.value = value;
+                        cell.seq.store(pos + 1U, std::memory_order_release);
+                        return true;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = _tail.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Only ever to be called by the one consuming task.
+        bool pop(T& value) noexcept
+        {
+            auto& cell = _cells[_head & (N - 1U)];
+            if (cell.seq.load(std::memory_order_acquire) != _head + 1U) {
+                return false;
+            }
+            value = cell.value;
+            cell.seq.store(_head + N, std::memory_order_release);
+            _head++;
+            return true;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> seq { 0U };
+            T value {};
+        };
+
+        std::array<Cell, N> _cells;
+        std::atomic<size_t> _tail { 0U };
+        size_t _head = 0U;
+    };
+
+    class IWindow;
+    class WindowContainer;
+    class IWindowContainer
+    {
+    public:
+        virtual WindowContainer& getChildren() noexcept = 0;
+        virtual bool hasChildren() = 0;
+        virtual size_t childCount() = 0;
+        virtual std::shared_ptr<IWindow> getChildByID(WindowID) = 0;
+        virtual bool setForegroundWindow(const std::shared_ptr<IWindow>&) = 0;
+        virtual void recalculateZOrder() = 0;
+        virtual bool addChild(const std::shared_ptr<IWindow>&) = 0;
+        virtual bool removeChildByID(WindowID) = 0;
+        virtual void removeAllChildren() = 0;
+        virtual void forEachChild(const std::function<bool(const std::shared_ptr<IWindow>&)>&) = 0;
+        virtual void forEachChildReverse(const std::function<bool(const std::shared_ptr<IWindow>&)>&) = 0;
+    };
+
+    class IWindow : public IWindowContainer
+    {
+    public:
+        virtual std::shared_ptr<IWindow> getParent() const = 0;
+
+        virtual GfxContextPtr getGfxContext() const = 0;
+        virtual bool hasGfxContext() const noexcept = 0;
+        virtual size_t getGfxContextSize() const noexcept = 0;
+        virtual uint32_t getGfxContextLastUsed() const noexcept = 0;
+        virtual size_t releaseGfxContext() = 0;
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+        virtual bool isGfxContextCompressible() const noexcept = 0;
+        virtual size_t compressGfxContext() = 0;
+# endif
+
+        virtual Rect getRect() const noexcept = 0;
+        virtual void setRect(const Rect&) noexcept = 0;
+        virtual void offsetRect(Coord, Coord) noexcept = 0;
+
+        virtual Rect getClientRect() const noexcept = 0;
+
+        virtual Rect getDirtyRect() const noexcept = 0;
+        virtual const Region& getDirtyRegion() const noexcept = 0;
+        virtual void markRectDirty(const Rect&) noexcept = 0;
+
+        virtual Style getStyle() const noexcept = 0;
+        virtual void setStyle(Style) noexcept = 0;
+
+        virtual WindowID getID() const noexcept = 0;
+
+        virtual uint8_t getZOrder() const noexcept = 0;
+        virtual void setZOrder(uint8_t) noexcept = 0;
+
+        virtual State getState() const noexcept = 0;
+        virtual void setState(State) noexcept = 0;
+
+        virtual const WindowText& getText() const noexcept = 0;
+        virtual void setText(std::string_view) = 0;
+
+        virtual Color getBgColor() const noexcept = 0;
+        virtual void setBgColor(Color) noexcept = 0;
+        virtual Color getTextColor() const noexcept = 0;
+        virtual void setTextColor(Color) noexcept = 0;
+        virtual Color getFrameColor() const noexcept = 0;
+        virtual void setFrameColor(Color) noexcept = 0;
+        virtual Color getShadowColor() const noexcept = 0;
+        virtual void setShadowColor(Color) noexcept = 0;
+
+        virtual Coord getCornerRadius() const noexcept = 0;
+        virtual void setCornerRadius(Coord) noexcept = 0;
 
         virtual bool routeMessage(Message, MsgParam, MsgParam) = 0;
         virtual bool queueMessage(Message, MsgParam, MsgParam) = 0;
         virtual bool processQueue() = 0;
         virtual bool processInput(InputParams*) = 0;
 
-        virtual bool redraw(bool = false) = 0;
-        virtual bool redrawChildren(bool = false) = 0;
-        virtual void redrawAsync() = 0;
-        virtual bool hide() noexcept = 0;
-        virtual bool show() noexcept = 0;
-        virtual bool isVisible() const noexcept = 0;
-        virtual bool isAlive() const noexcept = 0;
-        virtual bool isDirty() const noexcept = 0;
-        virtual void setDirty(bool) noexcept = 0;
-        virtual bool isDrawable() const noexcept = 0;
+        virtual bool redraw(bool = false) = 0;
+        virtual bool redrawChildren(bool = false) = 0;
+        virtual void redrawAsync() = 0;
+        virtual bool hide() noexcept = 0;
+        virtual bool show() noexcept = 0;
+        virtual bool isVisible() const noexcept = 0;
+        virtual bool isAlive() const noexcept = 0;
+        virtual bool isDirty() const noexcept = 0;
+        virtual void setDirty(bool) noexcept = 0;
+        virtual bool isDrawable() const noexcept = 0;
+
+        virtual bool destroy() = 0;
+
+        virtual WindowName toString() const = 0;
+
+    protected:
+        virtual bool onCreate(MsgParam, MsgParam) = 0;
+        virtual bool onDestroy(MsgParam, MsgParam) = 0;
+        virtual bool onDraw(MsgParam, MsgParam) = 0;
+        virtual bool onPostDraw(MsgParam, MsgParam) = 0;
+        virtual bool onInput(MsgParam, MsgParam) = 0;
+        virtual bool onEvent(MsgParam, MsgParam) = 0;
+        virtual bool onResize(MsgParam, MsgParam) = 0;
+        virtual bool onTimer(MsgParam, MsgParam) = 0;
+
+        virtual bool onTapped(Coord, Coord) = 0;
+        virtual bool onPressed(Coord, Coord) = 0;
+        virtual bool onDragged(Coord, Coord, Coord, Coord) = 0;
+        virtual bool onReleased(Coord, Coord) = 0;
+        virtual bool onLongPressed(Coord, Coord) = 0;
+        virtual bool onSwiped(SwipeDirection, Coord, Coord) = 0;
+    };
+
+    using WindowPtr          = std::shared_ptr<IWindow>;
+    using WindowContainerPtr = std::shared_ptr<IWindowContainer>;
+
+    class WindowContainer : public IWindowContainer
+    {
+    public:
+        // Most windows have no children: unlike a deque, an empty vector costs no heap.
+        using WindowList = std::vector<WindowPtr>;
+
+        WindowContainer() = default;
+        virtual ~WindowContainer() = default;
+
+        WindowContainer& getChildren() noexcept override { return *this; }
+
+        bool hasChildren() override
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            return !_children.empty();
+        }
+
+        size_t childCount() override
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            return _children.size();
+        }
+
+        WindowPtr getChildByID(WindowID id) override
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            for (const auto& win : _children) {
+                if (id == win->getID()) {
+                    return win;
+                }
+            }
+            return nullptr;
+        }
+
+        bool setForegroundWindow(const WindowPtr& win) override
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            bool success = false;
+            if (!win->getParent() && bitsHigh(win->getStyle(), Style::TopLevel)) {
+                for (auto it = _children.begin(); it != _children.end(); it++) {
+                    if ((*it)->getID() == win->getID()) {
+                        _children.erase(it);
+                        _children.push_back(win);
+                        success = true;
+                        break;
+                    }
+                }
+                if (success) {
+                    recalculateZOrder();
+                }
+            }
+            return success;
+        }
+
+        void recalculateZOrder() override
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            uint8_t zOrder = 0;
+            for (const auto& win : _children) {
+                win->setZOrder(zOrder);
+                zOrder++;
+            }
+        }
+
+        bool addChild(const WindowPtr& child) override
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            if (getChildByID(child->getID()) != nullptr) {
+                return false;
+            }
+            uint8_t zOrder = 0;
+            if (auto last = _children.rbegin(); last != _children.rend()) {
+                zOrder = (*last)->getZOrder() + 1;
+            }
+            child->setZOrder(zOrder);
+            _children.push_back(child);
+            return true;
+        }
+
+        bool removeChildByID(WindowID id) override
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            for (auto it = _children.begin(); it != _children.end(); it++) {
+                if (id == (*it)->getID()) {
+                    _children.erase(it);
+                    recalculateZOrder();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void removeAllChildren() override
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            _children.clear();
+        }
+
+        void forEachChild(const std::function<bool(const WindowPtr&)>& cb) override
+        {
+            if (!cb) {
+                return;
+            }
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            for (auto child : _children) {
+                if (!cb(child)) {
+                    break;
+                }
+            }
+        }
+
+        void forEachChildReverse(const std::function<bool(const WindowPtr&)>& cb) override
+        {
+            if (!cb) {
+                return;
+            }
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_getMutex());
+# endif
+            for (auto it = _children.rbegin(); it != _children.rend(); it++) {
+                if (!cb((*it))) {
+                    break;
+                }
+            }
+        }
+
+        /**
+         * Calls `visitor(child)` for each child, bottommost first, until it returns
+         * false. Unlike forEachChild(), children are visited by reference through an
+         * inlined visitor, so `visitor` must not add, remove, or reorder the children
+         * of this container (directly, or by way of a message handler).
+         */
+        template<typename TVisitor>
+        void visitChildren(TVisitor&& visitor)
+        {
+# if !defined(EWM_NOMUTEXES) && !defined(EWM_SINGLE_TREE_LOCK)
+            ScopeLock lock(_childMtx);
+# endif
+            for (const auto& child : _children) {
+                if (!visitor(child)) {
+                    break;
+                }
+            }
+        }
+
+        /** As visitChildren(), but topmost first. */
+        template<typename TVisitor>
+        void visitChildrenReverse(TVisitor&& visitor)
+        {
+# if !defined(EWM_NOMUTEXES) && !defined(EWM_SINGLE_TREE_LOCK)
+            ScopeLock lock(_childMtx);
+# endif
+            for (auto it = _children.rbegin(); it != _children.rend(); it++) {
+                if (!visitor(*it)) {
+                    break;
+                }
+            }
+        }
+
+    private:
+# if !defined(EWM_NOMUTEXES)
+        Mutex& _getMutex() noexcept
+        {
+#  if defined(EWM_SINGLE_TREE_LOCK)
+            return getTreeMutex();
+#  else
+            return _childMtx;
+#  endif
+        }
+# endif
+
+        WindowList _children;
+# if !defined(EWM_NOMUTEXES) && !defined(EWM_SINGLE_TREE_LOCK)
+        Mutex _childMtx;
+# endif
+    };
+
+    /**
+     * Uniform grid over the display which records the drawable windows overlapping
+     * each of its cells. Windows are held in paint order (each top-level window in
+     * Z-order, followed by its descendants depth-first), so walking the candidates
+     * of a query in reverse visits the topmost window first. Queries only narrow
+     * down the windows to look at; callers still test candidates' rects themselves.
+     */
+    class SpatialIndex
+    {
+    public:
+        static constexpr Extent CellSize = EWM_SPATIAL_CELL_PX;
+
+        struct Entry
+        {
+            WindowPtr win;
+            Rect rect;             /**< Window rect, clipped to each of its ancestors. */
+            bool topLevel = false;
+        };
+
+        void setBounds(Extent width, Extent height) noexcept
+        {
+            _cols = max(static_cast<size_t>(1U), (static_cast<size_t>(width) + CellSize - 1U) / CellSize);
+            _rows = max(static_cast<size_t>(1U), (static_cast<size_t>(height) + CellSize - 1U) / CellSize);
+            invalidate();
+        }
+
+        void invalidate() noexcept { _valid = false; }
+        bool isValid() const noexcept { return _valid; }
+
+        void rebuild(WindowContainer& registry)
+        {
+            EWM_ASSERT(!_querying);
+            _entries.clear();
+            registry.visitChildren([&](const WindowPtr& win)
+            {
+                _addWindow(win, win->getRect(), true);
+                return true;
+            });
+            _words = (_entries.size() + BitsPerWord - 1U) / BitsPerWord;
+            _cells.assign(_cols * _rows * _words, 0U);
+            _topLevel.assign(_words, 0U);
+            _scratch.assign(_words, 0U);
+            for (size_t idx = 0U; idx < _entries.size(); idx++) {
+                const auto bit = static_cast<Word>(1U) << (idx % BitsPerWord);
+                const auto word = idx / BitsPerWord;
+                if (_entries[idx].topLevel) {
+                    _topLevel[word] |= bit;
+                }
+                _forEachCell(_entries[idx].rect, [&](size_t cell)
+                {
+                    _cells[(cell * _words) + word] |= bit;
+                });
+            }
+            _valid = true;
+            EWM_LOG_V("rebuilt spatial index: %zu windows, %zux%zu cells", _entries.size(),
+                _cols, _rows);
+        }
+
+        size_t size() const noexcept { return _entries.size(); }
+
+        const Entry& operator[](size_t idx) const noexcept
+        {
+            EWM_ASSERT(idx < _entries.size());
+            return _entries[idx];
+        }
+
+        /** Calls `cb(entry)` for each candidate, bottommost first, until it returns false. */
+        template<typename TCallback>
+        void forEachCandidate(const Rect& rect, bool topLevelOnly, TCallback cb)
+        {
+            _query(rect, topLevelOnly);
+            for (size_t word = 0U; word < _words; word++) {
+                for (auto bits = _scratch[word]; bits != 0U; bits &= bits - 1U) {
+                    const auto idx = (word * BitsPerWord) + __builtin_ctz(bits);
+                    if (!cb(_entries[idx])) {
+                        _querying = false;
+                        return;
+                    }
+                }
+            }
+            _querying = false;
+        }
+
+        /** Calls `cb(entry)` for each candidate, topmost first, until it returns false. */
+        template<typename TCallback>
+        void forEachCandidateReverse(const Rect& rect, bool topLevelOnly, TCallback cb)
+        {
+            _query(rect, topLevelOnly);
+            for (size_t word = _words; word > 0U; word--) {
+                auto bits = _scratch[word - 1U];
+                while (bits != 0U) {
+                    const auto bit = (BitsPerWord - 1U) - __builtin_clz(bits);
+                    bits &= ~(static_cast<Word>(1U) << bit);
+                    if (!cb(_entries[((word - 1U) * BitsPerWord) + bit])) {
+                        _querying = false;
+                        return;
+                    }
+                }
+            }
+            _querying = false;
+        }
+
+    private:
+        using Word = uint32_t;
+        static constexpr size_t BitsPerWord = 32U;
+
+        void _addWindow(const WindowPtr& win, const Rect& clip, bool topLevel)
+        {
+            if (!win->isDrawable()) {
+                return;
+            }
+            // A child lying entirely outside of its parent can't be hit, and neither
+            // can its own children. (Its intersection would be Rect(), which
+            // pointWithin() considers to contain the origin.)
+            if (!topLevel && !win->getRect().intersectsRect(clip)) {
+                return;
+            }
+            const auto rect = topLevel ? win->getRect() : win->getRect().getIntersection(clip);
+            _entries.push_back({ win, rect, topLevel });
+            win->getChildren().visitChildren([&](const WindowPtr& child)
+            {
+                _addWindow(child, rect, false);
+                return true;
+            });
+        }
+
+        // Rects are treated as inclusive of their right and bottom edges here, as
+        // they are by Rect::pointWithin() and Rect::intersectsRect().
+        template<typename TCallback>
+        void _forEachCell(const Rect& rect, TCallback cb) const
+        {
+            const auto cell = [](Coord coord, size_t count)
+            {
+                return min(static_cast<size_t>(max(coord, static_cast<Coord>(0))) / CellSize, count - 1U);
+            };
+            const auto col0 = cell(rect.left, _cols), col1 = cell(rect.right, _cols);
+            const auto row0 = cell(rect.top, _rows), row1 = cell(rect.bottom, _rows);
+            for (auto row = row0; row <= row1; row++) {
+                for (auto col = col0; col <= col1; col++) {
+                    cb((row * _cols) + col);
+                }
+            }
+        }
+
+        void _query(const Rect& rect, bool topLevelOnly)
+        {
+            // Candidates are collected into a single scratch mask, so callbacks must
+            // not query the index themselves.
+            EWM_ASSERT(_valid && !_querying);
+            _querying = true;
+            std::fill(_scratch.begin(), _scratch.end(), 0U);
+            _forEachCell(rect, [&](size_t cell)
+            {
+                for (size_t word = 0U; word < _words; word++) {
+                    _scratch[word] |= _cells[(cell * _words) + word];
+                }
+            });
+            if (topLevelOnly) {
+                for (size_t word = 0U; word < _words; word++) {
+                    _scratch[word] &= _topLevel[word];
+                }
+            }
+        }
+
+        std::vector<Entry> _entries;
+        std::vector<Word> _cells;
+        std::vector<Word> _topLevel;
+        std::vector<Word> _scratch;
+        size_t _cols    = 1U;
+        size_t _rows    = 1U;
+        size_t _words   = 0U;
+        bool _valid     = false;
+        bool _querying  = false;
+    };
+
+    enum class WMState : uint8_t
+    {
+        None          = 0,
+        SSaverEnabled = 1 << 0,
+        SSaverActive  = 1 << 1,
+        SSaverDrawn   = 1 << 2
+    };
+
+# if defined(EWM_DAMAGE_DEBUG)
+    enum class DamageOverlay : uint8_t
+    {
+        None     = 0, /**< No overlay. */
+        Outline  = 1, /**< Each rect flushed is outlined (magenta). */
+        Overdraw = 2  /**< Pixels flushed are filled according to how many times they
+                           have been since the overlay went up: once green, twice
+                           yellow, three times orange, more red. */
+    };
+# endif
+
+# if defined(EWM_GFX_ADAFRUIT) && !defined(EWM_ADAFRUIT_RA8875)
+    /**
+     * Double-buffered flush stage for Adafruit_SPITFT displays. Rows of a dirty
+     * rect are packed into one of two DMA-capable bounce buffers, which is then
+     * handed to the SPI peripheral without blocking. While that transfer is in
+     * flight, the other buffer is filled (or the next window is composed); the CPU
+     * only waits when both buffers are busy, or the address window must change.
+     * Under EWM_COLOR_888, pixels are converted to the display's (big-endian RGB565)
+     * format as they're packed, so the driver has nothing left to do to them.
+     */
+    class FlushPipeline
+    {
+    public:
+        FlushPipeline() = default;
+        FlushPipeline(const FlushPipeline&) = delete;
+        FlushPipeline& operator=(const FlushPipeline&) = delete;
+
+        ~FlushPipeline()
+        {
+            _freeBuffers();
+        }
+
+        bool begin(const GfxDisplayPtr& display, size_t pixels = EWM_FLUSH_BUFFER_PX)
+        {
+            EWM_ASSERT(display);
+            _freeBuffers();
+            _display = display;
+            if (pixels == 0U) {
+                return true;
+            }
+            for (auto& buffer : _buffers) {
+# if defined(ESP32)
+                buffer = static_cast<uint16_t*>(
+                    heap_caps_malloc(pixels * sizeof(uint16_t), MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL)
+                );
+# else
+                buffer = static_cast<uint16_t*>(malloc(pixels * sizeof(uint16_t)));
+# endif
+                if (buffer == nullptr) {
+                    EWM_LOG_W("failed to allocate %zu byte flush buffer; using blocking"
+                        " writes", pixels * sizeof(uint16_t));
+                    _freeBuffers();
+                    return false;
+                }
+            }
+            _capacity = pixels;
+            EWM_LOG_V("allocated 2x %zu byte flush buffers", pixels * sizeof(uint16_t));
+            return true;
+        }
+
+        bool isBuffered() const noexcept { return _capacity > 0U; }
+
+        void flushRect(const GfxContextPtr& ctx, const Rect& clientRect, const Rect& displayRect)
+        {
+            EWM_ASSERT(_display && ctx);
+            const auto width  = clientRect.width();
+            const auto height = clientRect.height();
+            if (width == 0 || height == 0) {
+                return;
+            }
+            if (!_inFrame) {
+                _display->startWrite();
+                _inFrame = true;
+            }
+            // The address window may not be changed while pixels are still being
+            // clocked out to the current one.
+            _wait();
+            _display->setAddrWindow(displayRect.left, displayRect.top, width, height);
+            const Extent stride = ctx->width();
+            const Color* src = getGfxBuffer(ctx) + (clientRect.top * stride) + clientRect.left;
+            if (!isBuffered()) {
+                for (Extent row = 0; row < height; row++, src += stride) {
+# if defined(EWM_COLOR_888)
+                    _row.resize(width);
+                    PixelFormat::rgb888To565(src, _row.data(), width, true);
+                    _display->writePixels(_row.data(), width, true, true);
+# else
+                    _display->writePixels(const_cast<Color*>(src), width);
+# endif
+                }
+                return;
+            }
+            size_t packed = 0U;
+            for (Extent row = 0; row < height; row++, src += stride) {
+                Extent copied = 0;
+                while (copied < width) {
+                    const auto count = min(static_cast<size_t>(width - copied), _capacity - packed);
+# if defined(EWM_COLOR_888)
+                    PixelFormat::rgb888To565(src + copied, _buffers[_current] + packed, count, true);
+# else
+                    memcpy(_buffers[_current] + packed, src + copied, count * sizeof(Color));
+# endif
+                    packed += count;
+                    copied += count;
+                    if (packed == _capacity) {
+                        _transfer(packed);
+                        packed = 0U;
+                    }
+                }
+            }
+            if (packed > 0U) {
+                _transfer(packed);
+            }
+        }
+
+        void endFrame()
+        {
+            if (_inFrame) {
+                _wait();
+                _display->endWrite();
+                _inFrame = false;
+            }
+        }
+
+    private:
+        void _transfer(size_t count)
+        {
+            // Only one transfer may be queued at a time; the buffer being handed
+            // off was filled while the previous one was in flight.
+            _wait();
+# if defined(EWM_COLOR_888)
+            // Already in the display's byte order (see flushRect()).
+            _display->writePixels(_buffers[_current], count, false, true);
+# else
+            _display->writePixels(_buffers[_current], count, false);
+# endif
+            _inFlight = true;
+            _current ^= 1U;
+        }
+
+        void _wait()
+        {
+            if (_inFlight) {
+                _display->dmaWait();
+                _inFlight = false;
+            }
+        }
+
+        void _freeBuffers()
+        {
+            endFrame();
+            for (auto& buffer : _buffers) {
+# if defined(ESP32)
+                heap_caps_free(buffer);
+# else
+                free(buffer);
+# endif
+                buffer = nullptr;
+            }
+            _capacity = 0U;
+            _current  = 0U;
+        }
+
+        GfxDisplayPtr _display;
+        std::array<uint16_t*, 2> _buffers {};
+# if defined(EWM_COLOR_888)
+        std::vector<uint16_t> _row; /**< For unbuffered writes. */
+# endif
+        size_t _capacity = 0U;
+        uint8_t _current = 0U;
+        bool _inFlight   = false;
+        bool _inFrame    = false;
+    };
+# elif defined(EWM_GFX_ARDUINO)
+    /**
+     * Flush stage for Arduino_RGB_Display (parallel RGB panels). The panel is
+     * continuously scanned out of a framebuffer in PSRAM, so the rows of a dirty rect
+     * are copied straight into it, and only the cache lines they occupy are written
+     * back; the rest of the panel's framebuffer isn't touched.
+     */
+    class FlushPipeline
+    {
+    public:
+        bool begin(const GfxDisplayPtr& display)
+        {
+            EWM_ASSERT(display);
+            _display     = display;
+            _framebuffer = display->getFramebuffer();
+            if (_framebuffer == nullptr) {
+                EWM_LOG_W("panel framebuffer unavailable; using bitmap writes");
+                return false;
+            }
+            EWM_LOG_V("flushing directly to panel framebuffer %p", _framebuffer);
+            return true;
+        }
+
+        void flushRect(const GfxContextPtr& ctx, const Rect& clientRect, const Rect& displayRect)
+        {
+            EWM_ASSERT(_display && ctx);
+            const auto width  = clientRect.width();
+            const auto height = clientRect.height();
+            if (width == 0 || height == 0) {
+                return;
+            }
+            const Extent stride = ctx->width();
+            const Color* src = getGfxBuffer(ctx) + (clientRect.top * stride) + clientRect.left;
+            // The panel's framebuffer is laid out in its native orientation; when rotated,
+            // the library has to do the translating.
+            if (_framebuffer == nullptr || _display->getRotation() != 0) {
+                for (Extent row = 0; row < height; row++, src += stride) {
+                    _display->draw16bitRGBBitmap(displayRect.left, displayRect.top + row,
+                        const_cast<Color*>(src), width, 1);
+                }
+                return;
+            }
+            const Extent panelStride = _display->width();
+            Color* dst = _framebuffer + (displayRect.top * panelStride) + displayRect.left;
+            Color* const first = dst;
+            for (Extent row = 0; row < height; row++, src += stride, dst += panelStride) {
+                memcpy(dst, src, width * sizeof(Color));
+                if (width != panelStride) {
+                    _writeBack(dst, width);
+                }
+            }
+            // Full-width rows are contiguous, so they go back in one pass.
+            if (width == panelStride) {
+                _writeBack(first, static_cast<size_t>(width) * height);
+            }
+        }
+
+        void endFrame() { }
+
+    private:
+        static void _writeBack([[maybe_unused]] const Color* pixels, [[maybe_unused]] size_t count)
+        {
+# if defined(CONFIG_IDF_TARGET_ESP32S3)
+            constexpr uintptr_t mask = EWM_CACHE_LINE_BYTES - 1U;
+            const auto begin = reinterpret_cast<uintptr_t>(pixels) & ~mask;
+            const auto end   = (reinterpret_cast<uintptr_t>(pixels + count) + mask) & ~mask;
+            Cache_WriteBack_Addr(static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin));
+# endif
+        }
+
+        GfxDisplayPtr _display;
+        Color* _framebuffer = nullptr;
+    };
+# elif defined(EWM_ADAFRUIT_RA8875)
+    /**
+     * Flush stage for RA8875 displays. Each row of a dirty rect is sent in a single
+     * memory write burst, save for runs of one color long enough that having the
+     * controller fill them is cheaper than clocking out their pixels (backgrounds,
+     * mostly); consecutive rows of a single color become a single fill. Top-level
+     * windows which are moved are copied on the panel itself by the block transfer
+     * engine (BTE; see WindowManager::blitWindow()).
+     */
+    class FlushPipeline
+    {
+    public:
+        static constexpr size_t MaxBlits = 4U;
+
+        bool begin(const GfxDisplayPtr& display)
+        {
+            EWM_ASSERT(display);
+            _display   = display;
+            _blitCount = 0U;
+            return true;
+        }
+
+        void flushRect(const GfxContextPtr& ctx, const Rect& clientRect, const Rect& displayRect)
+        {
+            EWM_ASSERT(_display && ctx);
+            const auto width  = clientRect.width();
+            const auto height = clientRect.height();
+            if (width == 0 || height == 0) {
+                return;
+            }
+            const Extent stride = ctx->width();
+            const Color* src = getGfxBuffer(ctx) + (clientRect.top * stride) + clientRect.left;
+            Extent row = 0;
+            while (row < height) {
+                const Coord y = displayRect.top + row;
+                if (_runLength(src, width) == width) {
+                    Extent rows = 1;
+                    while (row + rows < height && src[rows * stride] == *src &&
+                        _runLength(src + (rows * stride), width) == width) {
+                        rows++;
+                    }
+                    if (static_cast<uint32_t>(width) * rows >= EWM_RA8875_FILL_RUN_PX) {
+                        _display->fillRect(displayRect.left, y, width, rows, toGfxColor(*src));
+                        row += rows;
+                        src += rows * stride;
+                        continue;
+                    }
+                }
+# if defined(EWM_COLOR_888)
+                _row.resize(width);
+                PixelFormat::rgb888To565(src, _row.data(), width, false);
+                _flushRow(_row.data(), width, displayRect.left, y);
+# else
+                _flushRow(src, width, displayRect.left, y);
+# endif
+                row++;
+                src += stride;
+            }
+        }
+
+        void endFrame() { }
+
+        // Queues a copy of `rect` (display coordinates) to `rect` offset by dx,dy.
+        // Returns false if the queue is full.
+        bool queueBlit(const Rect& rect, Coord dx, Coord dy) noexcept
+        {
+            if (_blitCount == MaxBlits) {
+                return false;
+            }
+            _blits[_blitCount++] = Blit {rect, dx, dy};
+            return true;
+        }
+
+        bool hasPendingBlits() const noexcept { return _blitCount > 0U; }
+
+        // Carries out the queued blits, in order. Must precede any flushes in the
+        // frame, since those assume that the pixels have already been moved.
+        void runBlits()
+        {
+            for (size_t n = 0U; n < _blitCount; n++) {
+                _blit(_blits[n]);
+            }
+            _blitCount = 0U;
+        }
+
+    private:
+        struct Blit
+        {
+            Rect rect;
+            Coord dx = 0;
+            Coord dy = 0;
+        };
+
+        // BTE registers and their bits (RA8875 datasheet, section 7-6).
+        static constexpr uint8_t RegBTECtrl0    = 0x50;
+        static constexpr uint8_t RegBTECtrl1    = 0x51;
+        static constexpr uint8_t RegSourceX     = 0x54;
+        static constexpr uint8_t RegSourceY     = 0x56;
+        static constexpr uint8_t RegDestX       = 0x58;
+        static constexpr uint8_t RegDestY       = 0x5a;
+        static constexpr uint8_t RegWidth       = 0x5c;
+        static constexpr uint8_t RegHeight      = 0x5e;
+        static constexpr uint8_t BTEBusy        = 0x80;
+        static constexpr uint8_t RopSource      = 0xc0;
+        static constexpr uint8_t OpMovePositive = 0x02;
+        static constexpr uint8_t OpMoveNegative = 0x03;
+
+        template<typename TPixel>
+        static Extent _runLength(const TPixel* pixels, Extent count) noexcept
+        {
+            Extent run = 1;
+            while (run < count && pixels[run] == *pixels) {
+                run++;
+            }
+            return run;
+        }
+
+        void _flushRow(const uint16_t* src, Extent width, Coord x, Coord y)
+        {
+            Extent start = 0;
+            Extent col   = 0;
+            while (col < width) {
+                const auto run = _runLength(src + col, width - col);
+                if (run >= EWM_RA8875_FILL_RUN_PX) {
+                    if (col > start) {
+                        _display->drawPixels(const_cast<uint16_t*>(src + start), col - start,
+                            x + start, y);
+                    }
+                    _display->fillRect(x + col, y, run, 1, src[col]);
+                    start = col + run;
+                }
+                col += run;
+            }
+            if (start < width) {
+                _display->drawPixels(const_cast<uint16_t*>(src + start), width - start, x + start, y);
+            }
+        }
+
+        void _blit(const Blit& blit)
+        {
+            // Where the source and destination overlap, the copy has to start at the
+            // end furthest from the destination: with the bottom right corner if
+            // moving down or to the right.
+            const bool reverse = blit.dy > 0 || (blit.dy == 0 && blit.dx > 0);
+            const Coord x = reverse ? blit.rect.right - 1 : blit.rect.left;
+            const Coord y = reverse ? blit.rect.bottom - 1 : blit.rect.top;
+            _writeReg16(RegSourceX, x);
+            _writeReg16(RegSourceY, y);
+            _writeReg16(RegDestX, x + blit.dx);
+            _writeReg16(RegDestY, y + blit.dy);
+            _writeReg16(RegWidth, blit.rect.width());
+            _writeReg16(RegHeight, blit.rect.height());
+            _display->writeReg(RegBTECtrl1, RopSource | (reverse ? OpMoveNegative : OpMovePositive));
+            _display->writeReg(RegBTECtrl0, BTEBusy);
+            _display->waitPoll(RegBTECtrl0, BTEBusy);
+        }
+
+        void _writeReg16(uint8_t reg, uint16_t value)
+        {
+            _display->writeReg(reg, value & 0xffU);
+            _display->writeReg(reg + 1U, value >> 8);
+        }
+
+        GfxDisplayPtr _display;
+        std::array<Blit, MaxBlits> _blits {};
+        size_t _blitCount = 0U;
+# if defined(EWM_COLOR_888)
+        std::vector<uint16_t> _row; /**< A row of the dirty rect, in RGB565. */
+# endif
+    };
+# endif
+
+# if !defined(EWM_NORENDERSTATS)
+    /**
+     * Fixed-size ring of per-frame statistics recorded by WindowManager::render().
+     * Only frames in which there was something to do (messages to process, or pixels
+     * to push) are recorded; idle passes are merely counted.
+     */
+    class RenderStats
+    {
+    public:
+        static constexpr size_t Capacity = EWM_RENDER_STATS_FRAMES;
+        static_assert(Capacity > 0U);
+
+        struct Frame
+        {
+            uint32_t timestamp     = 0U; // millis() at the start of the frame.
+            uint32_t composeMicros = 0U; // Processing messages and drawing windows.
+            uint32_t flushMicros   = 0U; // Pushing pixels to the display.
+            uint32_t pixels        = 0U;
+            uint16_t rects         = 0U;
+            uint16_t windows       = 0U; // Windows visited (including redrawn children).
+            uint16_t messages      = 0U;
+
+            uint32_t totalMicros() const noexcept { return composeMicros + flushMicros; }
+        };
+
+        struct Latency
+        {
+            uint32_t min  = 0U;
+            uint32_t max  = 0U;
+            uint32_t mean = 0U;
+            uint32_t p50  = 0U;
+            uint32_t p90  = 0U;
+            uint32_t p99  = 0U;
+        };
+
+        struct Summary
+        {
+            size_t frames = 0U; // Number of frames summarized (<= Capacity).
+            Latency total;
+            Latency compose;
+            Latency flush;
+            uint32_t meanPixels = 0U;
+            uint32_t maxPixels  = 0U;
+        };
+
+        void record(const Frame& frame) noexcept
+        {
+            _frames[_next] = frame;
+            _next = (_next + 1U) % Capacity;
+            _size = min(_size + 1U, Capacity);
+            _recorded++;
+        }
+
+        void countIdle() noexcept { _idle++; }
+
+        void reset() noexcept
+        {
+            _next     = 0U;
+            _size     = 0U;
+            _recorded = 0U;
+            _idle     = 0U;
+        }
+
+        bool empty() const noexcept { return _size == 0U; }
+        size_t size() const noexcept { return _size; }
+
+        // Frames recorded (and idle passes skipped) since construction or reset();
+        // unlike size(), these are not capped at Capacity.
+        uint32_t getRecordedFrames() const noexcept { return _recorded; }
+        uint32_t getIdleFrames() const noexcept { return _idle; }
+
+        // 0 is the oldest retained frame, size() - 1 the most recent.
+        const Frame& operator[](size_t index) const noexcept
+        {
+            EWM_ASSERT(index < _size);
+            return _frames[(_next + Capacity - _size + index) % Capacity];
+        }
+
+        const Frame& latest() const noexcept
+        {
+            return (*this)[_size - 1U];
+        }
+
+        Summary summarize() const noexcept
+        {
+            Summary summary;
+            summary.frames = _size;
+            if (_size == 0U) {
+                return summary;
+            }
+            uint64_t pixels = 0U;
+            for (size_t i = 0U; i < _size; i++) {
+                pixels += _frames[i].pixels;
+                summary.maxPixels = max(summary.maxPixels, _frames[i].pixels);
+            }
+            summary.meanPixels = static_cast<uint32_t>(pixels / _size);
+            summary.total   = _getLatency([](const Frame& f) { return f.totalMicros(); });
+            summary.compose = _getLatency([](const Frame& f) { return f.composeMicros; });
+            summary.flush   = _getLatency([](const Frame& f) { return f.flushMicros; });
+            return summary;
+        }
+
+    private:
+        template<typename TField>
+        Latency _getLatency(TField field) const noexcept
+        {
+            std::array<uint32_t, Capacity> sorted;
+            uint64_t sum = 0U;
+            for (size_t i = 0U; i < _size; i++) {
+                sorted[i] = field(_frames[i]);
+                sum += sorted[i];
+            }
+            std::sort(sorted.begin(), sorted.begin() + _size);
+            // Nearest-rank percentiles.
+            auto rank = [&](size_t pct)
+            {
+                return sorted[max(static_cast<size_t>(1U), (pct * _size + 99U) / 100U) - 1U];
+            };
+            Latency latency;
+            latency.min  = sorted[0];
+            latency.max  = sorted[_size - 1U];
+            latency.mean = static_cast<uint32_t>(sum / _size);
+            latency.p50  = rank(50U);
+            latency.p90  = rank(90U);
+            latency.p99  = rank(99U);
+            return latency;
+        }
+
+        std::array<Frame, Capacity> _frames {};
+        size_t _next       = 0U;
+        size_t _size       = 0U;
+        uint32_t _recorded = 0U;
+        uint32_t _idle     = 0U;
+    };
+# endif
+
+    /**
+     * One block of memory from which windows (along with their shared_ptr control
+     * blocks) are carved, one after another; see WindowManager::setWindowArena().
+     * Memory isn't reused as individual windows are freed, but all of it is, at once,
+     * when the last of them is: a screen built from an arena leaves no holes behind in
+     * the heap when torn down. Once full, further allocations come from the heap. Like
+     * the windows themselves, not to be used by more than one thread at a time.
+     */
+    class WindowArena
+    {
+    public:
+        explicit WindowArena(size_t capacity)
+            : _buffer(static_cast<uint8_t*>(malloc(capacity))),
+              _capacity(_buffer != nullptr ? capacity : 0U)
+        {
+            EWM_ASSERT(_buffer != nullptr);
+        }
+
+        // Carves windows out of `buffer` (e.g. statically allocated), which must
+        // outlive the arena. Suitably aligned for any type.
+        WindowArena(void* buffer, size_t capacity) noexcept
+            : _buffer(static_cast<uint8_t*>(buffer)), _capacity(capacity), _owned(false)
+        {
+            EWM_ASSERT(_buffer != nullptr);
+        }
+
+        WindowArena(const WindowArena&) = delete;
+        WindowArena& operator=(const WindowArena&) = delete;
+
+        ~WindowArena()
+        {
+            EWM_ASSERT(_live == 0U);
+            if (_owned) {
+                free(_buffer);
+            }
+        }
+
+        // Returns nullptr if there isn't room for `size` bytes.
+        void* allocate(size_t size, size_t align) noexcept
+        {
+            const auto addr = reinterpret_cast<uintptr_t>(_buffer) + _used;
+            const size_t pad = (align - (addr % align)) % align;
+            if (pad + size > _capacity - _used) {
+                _fallbacks++;
+                return nullptr;
+            }
+            _used += pad + size;
+            _live++;
+            return reinterpret_cast<void*>(addr + pad);
+        }
+
+        // Returns false if `ptr` was not allocated from this arena.
+        bool deallocate(void* ptr) noexcept
+        {
+            if (!owns(ptr)) {
+                return false;
+            }
+            EWM_ASSERT(_live > 0U);
+            if (--_live == 0U) {
+                _used = 0U;
+            }
+            return true;
+        }
+
+        bool owns(const void* ptr) const noexcept
+        {
+            const auto bytes = static_cast<const uint8_t*>(ptr);
+            return bytes >= _buffer && bytes < _buffer + _capacity;
+        }
+
+        // Rewinds the arena. Nothing allocated from it may still be alive.
+        void reset() noexcept
+        {
+            EWM_ASSERT(_live == 0U);
+            _live = 0U;
+            _used = 0U;
+        }
+
+        size_t getCapacity() const noexcept { return _capacity; }
+        size_t getUsed() const noexcept { return _used; }
+        size_t getLiveCount() const noexcept { return _live; }
+        size_t getFallbackCount() const noexcept { return _fallbacks; }
+
+    private:
+        uint8_t* _buffer  = nullptr;
+        size_t _capacity  = 0U;
+        size_t _used      = 0U;
+        size_t _live      = 0U;
+        size_t _fallbacks = 0U;
+        bool _owned       = true;
+    };
+
+    using WindowArenaPtr = std::shared_ptr<WindowArena>;
+
+    // Allocator for std::allocate_shared() which draws from a WindowArena (falling back
+    // to the heap when it's full). Keeps the arena alive for as long as anything
+    // allocated from it is.
+    template<typename T>
+    class ArenaAllocator
+    {
+    public:
+        using value_type = T;
+
+        explicit ArenaAllocator(const WindowArenaPtr& arena) noexcept : _arena(arena) { }
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) noexcept : _arena(other.getArena()) { }
+
+        T* allocate(size_t count)
+        {
+            if (auto ptr = _arena->allocate(count * sizeof(T), alignof(T))) {
+                return static_cast<T*>(ptr);
+            }
+            return static_cast<T*>(::operator new(count * sizeof(T)));
+        }
+
+        void deallocate(T* ptr, size_t) noexcept
+        {
+            if (!_arena->deallocate(ptr)) {
+                ::operator delete(ptr);
+            }
+        }
+
+        const WindowArenaPtr& getArena() const noexcept { return _arena; }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U>& other) const noexcept
+        {
+            return _arena == other.getArena();
+        }
+
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U>& other) const noexcept
+        {
+            return !(*this == other);
+        }
+
+    private:
+        WindowArenaPtr _arena;
+    };
+
+    class WindowManager : public std::enable_shared_from_this<WindowManager>
+    {
+    public:
+        struct Config
+        {
+            uint32_t minHitTestIntervalMsec = 0U;
+            uint8_t maxFramesPerSec         = 0U; /**< 0 = as often as render() is called. */
+            uint16_t dragThresholdPx        = 8U; /**< Travel before a touch becomes a drag. */
+            uint16_t longPressMsec          = 600U;
+            uint16_t swipeMinPxPerSec       = 600U; /**< Average speed of a drag to be a swipe. */
+            /**
+             * Bytes of top-level gfx contexts beyond which those of hidden windows are
+             * released, least recently used first; 0 = no limit. Ignored with
+             * EWM_SHARED_FRAMEBUFFER.
+             */
+            uint32_t gfxContextBudget       = 0U;
+        };
+
+        static constexpr uint32_t DefaultMinHitTestIntervalMsec = 200U;
+        static constexpr uint8_t DefaultMaxFramesPerSec         = 60U;
+
+        /** Returned by getMsecUntilNextFrame() when nothing is scheduled. */
+        static constexpr uint32_t NoDeadline = UINT32_MAX;
+
+        WindowManager() = delete;
+
+        explicit WindowManager(
+            const GfxDisplayPtr& gfxDisplay,
+            const ThemePtr& theme,
+            const Font* defaultFont,
+            const Config* config = nullptr
+        ) : _registry(std::make_shared<WindowContainer>()),
+            _gfxDisplay(gfxDisplay), _theme(theme)
+        {
+            EWM_ASSERT(_registry);
+            EWM_ASSERT(_gfxDisplay);
+            EWM_ASSERT(_theme);
+            _theme->setDefaultFont(defaultFont);
+            if (config != nullptr) {
+                _config = *config;
+            } else {
+                _config.minHitTestIntervalMsec = DefaultMinHitTestIntervalMsec;
+                _config.maxFramesPerSec        = DefaultMaxFramesPerSec;
+            }
+        }
+
+        virtual ~WindowManager()
+        {
+# if defined(EWM_RENDER_TASK)
+            stopRenderTask();
+# endif
+            tearDown();
+        }
 
-        virtual bool destroy() = 0;
+        void setState(WMState state) noexcept { _state = state; }
+        WMState getState() const noexcept { return _state; }
+
+        Config getConfig() const noexcept { return _config; }
+        void setConfig(const Config& config) noexcept { _config = config; }
+
+        void enableScreensaver(uint32_t activateAfterMsec) noexcept
+        {
+            _ssTimerMsec = activateAfterMsec;
+            _ssLastActivity = millis();
+            setState(getState() | WMState::SSaverEnabled);
+            EWM_LOG_D("screensaver enabled (%ums)", activateAfterMsec);
+        }
+
+        void disableScreensaver() noexcept
+        {
+            EWM_CONST(WMState, flags,
+                WMState::SSaverEnabled | WMState::SSaverActive | WMState::SSaverDrawn);
+            setState(getState() & ~flags);
+            EWM_LOG_D("screensaver disabled");
+        }
+
+        virtual void tearDown()
+        {
+            _registry->forEachChild([](const WindowPtr& child)
+            {
+                child->destroy();
+                return true;
+            });
+            _registry->removeAllChildren();
+            invalidateSpatialIndex();
+        }
+
+        // Destroys `win` and its descendants, and detaches it from its parent (or from
+        // the top level), so that its memory is freed once the caller lets go of it.
+        bool destroyWindow(const WindowPtr& win)
+        {
+            EWM_ASSERT(win);
+            const bool destroyed = win->destroy();
+            const auto parent    = win->getParent();
+            const bool removed   = parent ? parent->removeChildByID(win->getID())
+                : _registry->removeChildByID(win->getID());
+            invalidateSpatialIndex();
+            return destroyed && removed;
+        }
+
+        ThemePtr getTheme() const { return _theme; }
+        GfxDisplayPtr getGfxDisplay() const { return _gfxDisplay; }
+
+        // Windows created from now on are allocated from `arena`, or from the heap if
+        // null (the default). E.g., set an arena while building a screen that will be
+        // torn down again, and clear it afterwards.
+        void setWindowArena(const WindowArenaPtr& arena) noexcept { _windowArena = arena; }
+        WindowArenaPtr getWindowArena() const noexcept { return _windowArena; }
+
+        Extent getDisplayWidth() const noexcept { return _gfxDisplay->width(); }
+        Extent getDisplayHeight() const noexcept { return _gfxDisplay->height(); }
+
+        Rect getDisplayRect() const noexcept
+        {
+            return Rect(0, 0, getDisplayWidth(), getDisplayHeight());
+        }
+
+        template<class TWindow>
+        std::shared_ptr<TWindow> createWindow(
+            const WindowPtr& parent,
+            WindowID id,
+            Style style,
+            Coord x,
+            Coord y,
+            Extent width,
+            Extent height,
+            std::string_view text = std::string_view(),
+            const std::function<bool(const std::shared_ptr<TWindow>&)>& preCreateHook = nullptr
+        )
+        {
+            if (id == WID_INVALID) {
+                EWM_LOG_E("%hhu is a reserved window ID", WID_INVALID);
+                return nullptr;
+            }
+            if (bitsHigh(style, Style::FullScreen)) {
+                x      = 0;
+                y      = 0;
+                width  = getDisplayWidth();
+                height = getDisplayHeight();
+            }
+            Rect rect(x, y, x + width, y + height);
+# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
+            EWM_CONST(size_t, MaxClassName, 32);
+            std::array<char, MaxClassName> demangleBuf;
+            size_t dbufSize    = MaxClassName;
+            int status         = 0;
+            const auto clsName = __cxxabiv1::__cxa_demangle(
+                typeid(TWindow).name(),
+                demangleBuf.data(),
+                &dbufSize,
+                &status
+            );
+            EWM_ASSERT(clsName != nullptr && status == 0);
+            std::shared_ptr<TWindow> win(
+                _makeWindow<TWindow>(
+                    shared_from_this(), parent, id, style, rect, text, clsName
+                )
+            );
+            demangleBuf.fill('\0');
+# else
+            std::shared_ptr<TWindow> win(
+                _makeWindow<TWindow>(
+                    shared_from_this(), parent, id, style, rect, text
+                )
+            );
+# endif
+            if (bitsHigh(style, Style::Child) && !parent) {
+                EWM_LOG_E("%s: Style::Child && null parent", win->toString().c_str());
+                return nullptr;
+            }
+            if (bitsHigh(style, Style::TopLevel) && parent) {
+                EWM_LOG_E("%s: Style::TopLevel && parent", win->toString().c_str());
+                return nullptr;
+            }
+            if (preCreateHook && !preCreateHook(win)) {
+                EWM_LOG_E("%s: pre-create hook failed", win->toString().c_str());
+                return nullptr;
+            }
+            if (!win->routeMessage(Message::Create)) {
+                EWM_LOG_E("%s: Message::Create = false", win->toString().c_str());
+                return nullptr;
+            }
+            bool dupe = parent ? !parent->addChild(win) : !_registry->addChild(win);
+            if (dupe) {
+                EWM_LOG_E("duplicate window ID %hhu (parent: %hhu)",
+                    id, parent ? parent->getID() : WID_INVALID);
+                return nullptr;
+            }
+            if (bitsHigh(win->getStyle(), Style::AutoSize)) {
+                win->routeMessage(Message::Resize);
+            }
+            invalidateSpatialIndex();
+            win->markRectDirty(rect);
+            win->redraw();
+            return win;
+        }
+
+        template<class TPrompt>
+        std::shared_ptr<TPrompt> createPrompt(
+            const WindowPtr& parent,
+            WindowID id,
+            Style style,
+            std::string_view text,
+            const std::deque<typename TPrompt::ButtonInfo>& buttons,
+            const typename TPrompt::ResultCallback& callback
+        )
+        {
+            EWM_ASSERT(bitsHigh(style, Style::Prompt));
+            const Extent width = min(
+                _theme->getMetric(MetricID::MaxPromptCX).getExtent(),
+                static_cast<Extent>(
+                    getDisplayWidth() - (_theme->getMetric(MetricID::XPadding).getExtent() * 2)
+                )
+            );
+            const Extent height = min(
+                _theme->getMetric(MetricID::MaxPromptCY).getExtent(),
+                static_cast<Extent>(
+                    getDisplayHeight() - (_theme->getMetric(MetricID::YPadding).getExtent() * 2)
+                )
+            );
+            auto prompt = createWindow<TPrompt>(
+                parent,
+                id,
+                style,
+                (getDisplayWidth() / 2) - (width / 2),
+                (getDisplayHeight() / 2) - (height / 2),
+                width,
+                height,
+                text,
+                [&](const std::shared_ptr<TPrompt>& win)
+                {
+                    for (const auto& btn : buttons) {
+                        if (!win->addButton(btn)) {
+                            return false;
+                        }
+                    }
+                    win->setResultCallback(callback);
+                    return true;
+                }
+            );
+            return prompt;
+        }
+
+        template<class TBar>
+        std::shared_ptr<TBar> createProgressBar(
+            const WindowPtr& parent,
+            WindowID id,
+            Style style,
+            Coord x,
+            Coord y,
+            Extent width,
+            Extent height,
+            ProgressStyle pbarStyle
+        )
+        {
+            auto pbar = createWindow<TBar>(
+                parent, id, style, x, y, width, height
+            );
+            if (pbar) {
+                pbar->setProgressBarStyle(pbarStyle);
+            }
+            return pbar;
+        }
+
+        bool setForegroundWindow(const WindowPtr& win)
+        {
+            invalidateSpatialIndex();
+            return _registry->setForegroundWindow(win);
+        }
+
+        // Must be called whenever a window's rect, visibility, Z-order, or place in
+        // the hierarchy changes. The index is rebuilt the next time it is queried.
+        void invalidateSpatialIndex() noexcept
+        {
+            _spatialIndex.invalidate();
+        }
+
+# if !defined(EWM_NORENDERSTATS)
+        // Statistics for the most recently rendered frames. Not synchronized; read it
+        // from the thread that calls render(), or while holding getTreeMutex() with
+        // EWM_SINGLE_TREE_LOCK defined.
+        const RenderStats& getRenderStats() const noexcept { return _renderStats; }
+        void resetRenderStats() noexcept { _renderStats.reset(); }
+# endif
+
+        // Called by windows for each message taken from their queue.
+        void countProcessedMessage() noexcept
+        {
+# if !defined(EWM_NORENDERSTATS)
+            _frameStats.messages++;
+# endif
+        }
+
+        // Called by windows whenever they queue a message or mark part of themselves
+        // dirty. render() skips frames (cheaply) for which nothing has done so.
+        void requestRender() noexcept
+        {
+            _renderRequested.store(true, std::memory_order_relaxed);
+# if defined(EWM_RENDER_TASK)
+            _wakeRenderTask();
+# endif
+        }
+
+        // Requests a frame no sooner than `delayMsec` from now (e.g. for the next step
+        // of an animation); only the earliest of any pending such requests is kept.
+        void requestRenderIn(uint32_t delayMsec) noexcept
+        {
+            const uint32_t now = millis();
+            if (!_wakePending || static_cast<int32_t>(now + delayMsec - _wakeAtMsec) < 0) {
+                _wakeAtMsec  = now + delayMsec;
+                _wakePending = true;
+# if defined(EWM_RENDER_TASK)
+                _wakeRenderTask();
+# endif
+            }
+        }
+
+        // Batches changes to many windows (e.g. a screen's worth of values or colors
+        // refreshed at once) into a single composite. Until the outermost endUpdate(),
+        // redrawAsync() (and so every property setter) only records the window, and no
+        // frame is rendered. endUpdate() then merges what the recorded windows cover
+        // into one dirty region per top-level window, which the next frame redraws
+        // (children and all) and flushes, even if windows are moved or scrolled in
+        // the meantime. Calls nest. This is not a lock; with
+        // EWM_RENDER_TASK, hold getTreeMutex() across the update as usual.
+        void beginUpdate() noexcept
+        {
+            _updateDepth++;
+        }
+
+        void endUpdate()
+        {
+            EWM_ASSERT(_updateDepth > 0U);
+            if (_updateDepth == 0U || --_updateDepth > 0U) {
+                return;
+            }
+            for (size_t i = 0U; i < _pendingUpdates.size(); i++) {
+                if (!_pendingUpdates[i]) {
+                    continue;
+                }
+                const auto topLevel = _getTopLevel(_pendingUpdates[i]);
+                Region damage;
+                bool redrawTopLevel = false;
+                for (size_t j = i; j < _pendingUpdates.size(); j++) {
+                    auto& win = _pendingUpdates[j];
+                    if (!win || _getTopLevel(win) != topLevel) {
+                        continue;
+                    }
+                    if (win == topLevel) {
+                        redrawTopLevel = true;
+                    } else if (win->isDrawable()) {
+                        damage.unite(win->getRect());
+                    }
+                    win.reset();
+                }
+                // Windows that can't be drawn now stay dirty until they can.
+                if (!topLevel || !topLevel->isDrawable()) {
+                    continue;
+                }
+                if (redrawTopLevel) {
+                    damage = Region(topLevel->getRect());
+                    topLevel->queueMessage(Message::Draw, 0U, 0U);
+                }
+                if (damage.empty()) {
+                    continue;
+                }
+                // Until the next frame redraws the children there, the gfx context
+                // isn't current, whatever moves or scrolls in the meantime.
+                topLevel->setState((topLevel->getState() & ~State::Composed) | State::Undrawn);
+                damage.coalesce();
+                for (const auto& rect : damage) {
+                    topLevel->markRectDirty(rect);
+                }
+            }
+            _pendingUpdates.clear();
+            requestRender();
+        }
+
+        bool isUpdating() const noexcept { return _updateDepth > 0U; }
+
+        // Called by windows in redrawAsync(). Returns false if no update is open, in
+        // which case the window is to queue its own redraw.
+        bool deferRedraw(const WindowPtr& win)
+        {
+            if (_updateDepth == 0U) {
+                return false;
+            }
+            if (std::find(_pendingUpdates.begin(), _pendingUpdates.end(), win) ==
+                _pendingUpdates.end()) {
+                _pendingUpdates.push_back(win);
+            }
+            return true;
+        }
+
+        /** Handed the current value of an animation, once per frame (see animate()). */
+        using AnimationCallback = std::function<void(const WindowPtr&, float)>;
+
+        // Sends Message::Timer (p1 = id) to `win` every `intervalMsec` (or just once,
+        // unless `repeat`), at the start of the first frame due after each interval has
+        // elapsed. Setting a timer (or animation) that is already set restarts it.
+        // Returns false if EWM_MAX_TIMERS timers and animations are already running.
+        bool setTimer(const WindowPtr& win, TimerID id, uint32_t intervalMsec,
+            bool repeat = true)
+        {
+            auto timer = _getTimer(win, id);
+            if (timer == nullptr) {
+                EWM_LOG_W("%s: no timers left for %hhu", win->toString().c_str(), id);
+                return false;
+            }
+            timer->startMsec    = millis();
+            timer->intervalMsec = intervalMsec;
+            timer->dueMsec      = timer->startMsec + intervalMsec;
+            timer->repeat       = repeat;
+            requestRenderIn(intervalMsec);
+            return true;
+        }
 
-        virtual std::string toString() const = 0;
+        // Tweens a value from `from` to `to` over `durationMsec`, handing it to `apply` at
+        // the start of every frame until it gets there (or, if `repeat`, starting over
+        // each time it does). Windows updated by any number of animations are thus
+        // redrawn together, in one pass per frame, at the frame rate of Config. Shares
+        // IDs (and EWM_MAX_TIMERS) with setTimer(); returns false if none are left.
+        bool animate(const WindowPtr& win, TimerID id, float from, float to,
+            uint32_t durationMsec, const AnimationCallback& apply,
+            Easing easing = Easing::Linear, bool repeat = false)
+        {
+            EWM_ASSERT(apply);
+            auto timer = _getTimer(win, id);
+            if (timer == nullptr) {
+                EWM_LOG_W("%s: no timers left for %hhu", win->toString().c_str(), id);
+                return false;
+            }
+            timer->apply        = apply;
+            timer->startMsec    = millis();
+            timer->intervalMsec = durationMsec;
+            timer->from         = from;
+            timer->to           = to;
+            timer->easing       = easing;
+            timer->repeat       = repeat;
+            requestRender();
+            return true;
+        }
 
-    protected:
-        virtual bool onCreate(MsgParam, MsgParam) = 0;
-        virtual bool onDestroy(MsgParam, MsgParam) = 0;
-        virtual bool onDraw(MsgParam, MsgParam) = 0;
-        virtual bool onPostDraw(MsgParam, MsgParam) = 0;
-        virtual bool onInput(MsgParam, MsgParam) = 0;
-        virtual bool onEvent(MsgParam, MsgParam) = 0;
-        virtual bool onResize(MsgParam, MsgParam) = 0;
+        // Stops a timer or animation; returns false if `win` had none by that ID. An
+        // animation stopped this way leaves its value where it was.
+        bool killTimer(const WindowPtr& win, TimerID id) noexcept
+        {
+            for (auto& timer : _timers) {
+                if (timer.key == win.get() && timer.id == id) {
+                    timer = Timer();
+                    return true;
+                }
+            }
+            return false;
+        }
 
-        virtual bool onTapped(Coord, Coord) = 0;
-    };
+        bool isTimerSet(const WindowPtr& win, TimerID id) const noexcept
+        {
+            for (const auto& timer : _timers) {
+                if (timer.key == win.get() && timer.id == id) {
+                    return true;
+                }
+            }
+            return false;
+        }
 
-    using WindowPtr          = std::shared_ptr<IWindow>;
-    using WindowContainerPtr = std::shared_ptr<IWindowContainer>;
+        // Queues a tap at x,y (display coordinates) to be hit tested at the start of the
+        // next call to render(). Safe to call from any task, and never blocks; returns
+        // false (and the tap is dropped) if EWM_INPUT_QUEUE_LEN of them are waiting.
+        bool postInput(Coord x, Coord y) noexcept
+        {
+            PackagedMessage pm;
+            pm.msg = Message::Input;
+            pm.p1  = static_cast<MsgParam>(InputType::Tap);
+            pm.p2  = makeMsgParam(static_cast<MsgParamWord>(x), static_cast<MsgParamWord>(y));
+            if (!_inputQueue.push(pm)) {
+                return false;
+            }
+            requestRender();
+            return true;
+        }
 
-    class WindowContainer : public IWindowContainer
-    {
-    public:
-        using WindowDeque = std::deque<WindowPtr>;
+        // Queues a sample from the touch controller for `pointer` (< EWM_MAX_POINTERS):
+        // whether it's down, and if so, where (display coordinates). Samples may be posted
+        // at whatever rate the controller produces them, and only changes matter: the
+        // next frame turns them into gestures (see InputType). While a pointer is down,
+        // only its latest position is kept, so moves never take up more than one slot in
+        // the queue. Each pointer's samples must come from one task at a time. Returns
+        // false if the sample was dropped for want of room.
+        bool postTouch(Coord x, Coord y, bool down, uint8_t pointer = 0U) noexcept
+        {
+            EWM_ASSERT(pointer < EWM_MAX_POINTERS);
+            if (pointer >= EWM_MAX_POINTERS) {
+                return false;
+            }
+            auto& posted = _postedPointers[pointer];
+            if (down && posted.down) {
+                posted.position.store(makeMsgParam(static_cast<MsgParamWord>(x),
+                    static_cast<MsgParamWord>(y)), std::memory_order_release);
+                if (posted.movePending.exchange(true, std::memory_order_acq_rel)) {
+                    return true;
+                }
+                if (!_postTouch(InputType::Drag, pointer, 0U)) {
+                    posted.movePending.store(false, std::memory_order_relaxed);
+                    return false;
+                }
+                return true;
+            }
+            if (down == posted.down) {
+                return true;
+            }
+            if (!_postTouch(down ? InputType::Press : InputType::Release, pointer,
+                makeMsgParam(static_cast<MsgParamWord>(x), static_cast<MsgParamWord>(y)))) {
+                return false;
+            }
+            posted.down = down;
+            return true;
+        }
 
-        WindowContainer() = default;
-        virtual ~WindowContainer() = default;
+# if defined(EWM_RENDER_TASK)
+        // Starts calling render() from a task of its own (see EWM_RENDER_TASK), which
+        // sleeps for as long as getMsecUntilNextFrame() allows, or until new work is
+        // requested. render() must not be called from anywhere else while it runs.
+        bool startRenderTask()
+        {
+            if (_renderTask.load() != nullptr) {
+                return true;
+            }
+            _renderTaskExited.store(false);
+            _renderTaskStop.store(false);
+            TaskHandle_t task = nullptr;
+            const auto created = xTaskCreatePinnedToCore(&WindowManager::_renderTaskProc,
+                "ewm_render", EWM_RENDER_TASK_STACK, this, EWM_RENDER_TASK_PRIORITY, &task,
+                EWM_RENDER_TASK_CORE);
+            if (created != pdPASS) {
+                EWM_LOG_E("failed to create render task (%d)", created);
+                return false;
+            }
+            _renderTask.store(task);
+            EWM_LOG_D("render task started on core %d", EWM_RENDER_TASK_CORE);
+            return true;
+        }
 
-        bool hasChildren() override
+        // Blocks until the render task, if running, has finished its current frame and
+        // exited. Must not be called from the render task itself.
+        void stopRenderTask()
         {
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
-# endif
-            return !_children.empty();
+            auto task = _renderTask.load();
+            if (task == nullptr) {
+                return;
+            }
+            EWM_ASSERT(task != xTaskGetCurrentTaskHandle());
+            _renderTaskStop.store(true);
+            xTaskNotifyGive(task);
+            while (!_renderTaskExited.load()) {
+                vTaskDelay(1);
+            }
+            _renderTask.store(nullptr);
+            EWM_LOG_D("render task stopped");
         }
 
-        size_t childCount() override
+        bool isRenderTaskRunning() const noexcept
         {
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
+            return _renderTask.load() != nullptr;
+        }
 # endif
-            return _children.size();
+
+        // Called once per frame, just before the first pixel of it is sent to the display;
+        // e.g. to wait for the panel's vertical blanking or tearing effect (TE) signal, on
+        // displays which expose one.
+        void setFrameSyncCallback(const std::function<void()>& callback)
+        {
+            _frameSync = callback;
         }
 
-        WindowPtr getChildByID(WindowID id) override
+# if defined(EWM_DAMAGE_DEBUG)
+        // Draws the selected overlay over what each frame flushes, directly to the
+        // display. EWM_DAMAGE_OVERLAY_MSEC after it goes up, what it covers is flushed
+        // again (and the overdraw counts start over).
+        DamageOverlay getDamageOverlay() const noexcept { return _damageOverlay; }
+
+        void setDamageOverlay(DamageOverlay overlay) noexcept
         {
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
+            _damageOverlay = overlay;
+            if (overlay == DamageOverlay::None && !_overlayRegion.empty()) {
+                _overlayDueMsec = millis();
+                requestRender();
+            }
+        }
+
+        // Handed a record of each frame which flushed anything, once the frame is done
+        // (e.g. to write it to Serial). All fields are little-endian:
+        //
+        //   uint8_t  'E', 'D'       marker
+        //   uint16_t frame          incremented per record (wraps)
+        //   uint32_t timestamp      millis() at the start of the frame
+        //   uint32_t composeMicros  0 if EWM_NORENDERSTATS is defined
+        //   uint32_t flushMicros    0 if EWM_NORENDERSTATS is defined
+        //   uint32_t pixels         flushed (sum of rect areas)
+        //   uint16_t rects          flushed
+        //   uint16_t recorded       rects that follow (<= EWM_DAMAGE_LOG_RECTS)
+        //   int16_t  left, top, right, bottom (display coordinates), per rect
+        //
+        // The damage overlay's own flushes aren't included.
+        using DamageLogCallback = std::function<void(const uint8_t*, size_t)>;
+
+        void setDamageLogCallback(const DamageLogCallback& callback)
+        {
+            _damageLog = callback;
+        }
 # endif
-            for (const auto& win : _children) {
-                if (id == win->getID()) {
-                    return win;
-                }
+
+        // Milliseconds until render() next has something to do: a requested frame (once
+        // the frame rate cap allows), a requestRenderIn() deadline, or the screensaver
+        // kicking in. Returns 0 if a frame is due now, or NoDeadline if nothing is
+        // pending at all, in which case only input (or the application) can create work.
+        // Callers may spend the time asleep, as long as they still poll for input.
+        uint32_t getMsecUntilNextFrame() const noexcept
+        {
+            // endUpdate() requests a frame of its own.
+            if (_updateDepth > 0U) {
+                return NoDeadline;
             }
-            return nullptr;
+            const uint32_t now = millis();
+            uint32_t wait      = NoDeadline;
+            if (_renderRequested.load(std::memory_order_relaxed)) {
+                wait = _getMsecUntilFrameSlot();
+            }
+            if (_wakePending) {
+                const auto remaining = static_cast<int32_t>(_wakeAtMsec - now);
+                wait = min(wait, static_cast<uint32_t>(max(remaining, static_cast<int32_t>(0))));
+            }
+            if (bitsHigh(getState(), WMState::SSaverEnabled) &&
+                !bitsHigh(getState(), WMState::SSaverActive)) {
+                const uint32_t idle = now - _ssLastActivity;
+                wait = min(wait, idle >= _ssTimerMsec ? 0U : _ssTimerMsec - idle);
+            }
+            return wait;
         }
 
-        bool setForegroundWindow(const WindowPtr& win) override
+        bool isFrameDue() const noexcept
         {
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
+            return getMsecUntilNextFrame() == 0U;
+        }
+
+        void hitTest(Coord x, Coord y)
+        {
+            if (millis() - _lastHitTestTime < _config.minHitTestIntervalMsec) {
+                return;
+            }
+            EWM_ASSERT(x >= 0 && y >= 0);
+            EWM_ASSERT(x <= getDisplayWidth() && y <= getDisplayHeight());
+            EWM_LOG_D("hit test at %hd,%hd", x, y);
+# if !defined(EWM_NOMUTEXES) && defined(EWM_SINGLE_TREE_LOCK)
+            ScopeLock treeLock(getTreeMutex());
 # endif
-            bool success = false;
-            if (!win->getParent() && bitsHigh(win->getStyle(), Style::TopLevel)) {
-                for (auto it = _children.begin(); it != _children.end(); it++) {
-                    if ((*it)->getID() == win->getID()) {
-                        _children.erase(it);
-                        _children.push_back(win);
-                        success = true;
-                        break;
-                    }
+            if (bitsHigh(getState(), WMState::SSaverEnabled)) {
+                _ssLastActivity = millis();
+                if (bitsHigh(getState(), WMState::SSaverActive)) {
+                    // The next frame dismisses the screensaver.
+                    requestRender();
+                    return;
                 }
-                if (success) {
-                    recalculateZOrder();
+            }
+            [[maybe_unused]] bool claimed = false;
+            // The topmost (and deepest) window containing the point is offered the
+            // input first; its ancestors are only consulted should it decline.
+            _getSpatialIndex().forEachCandidateReverse(Rect(x, y, x, y), false,
+                [&](const SpatialIndex::Entry& entry)
+            {
+                if (!entry.rect.pointWithin(x, y)) {
+                    return true;
+                }
+                const auto& child = entry.win;
+                EWM_LOG_V("interrogating %s re: hit test at %hd,%hd",
+                    child->toString().c_str(), x, y);
+                InputParams params;
+                params.type = InputType::Tap;
+                params.x    = x;
+                params.y    = y;
+                if (child->processInput(&params)) {
+                    EWM_LOG_V("%s claimed hit test at %hd,%hd",
+                        params.handledBy.c_str(), x, y);
+                    claimed = true;
+                    return false;
                 }
+                return true;
+            });
+            if (!claimed) {
+                EWM_LOG_V("hit test at %hd,%hd unclaimed", x, y);
             }
-            return success;
+            _lastHitTestTime = millis();
         }
 
-        void recalculateZOrder() override
+        bool isWindowEntirelyCovered(const WindowPtr& win)
         {
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
-# endif
-            uint8_t zOrder = 0;
-            for (const auto& win : _children) {
-                win->setZOrder(zOrder);
-                zOrder++;
+            bool covered = false;
+            const auto rect = win->getRect();
+            auto topLevel = win;
+            while (auto parent = topLevel->getParent()) {
+                topLevel = parent;
             }
+            _getSpatialIndex().forEachCandidateReverse(rect, true,
+                [&](const SpatialIndex::Entry& entry)
+            {
+                if (entry.win == topLevel || entry.win->getZOrder() < topLevel->getZOrder()) {
+                    return false;
+                }
+                if (rect.withinRect(entry.rect)) {
+                    covered = true;
+                    return false;
+                }
+                return true;
+            });
+            return covered;
         }
 
-        bool addChild(const WindowPtr& child) override
+        // Returns true if any top-level window above that of `win` overlaps `rect`.
+        bool isRectOverlappedFromAbove(const WindowPtr& win, const Rect& rect)
         {
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
-# endif
-            if (getChildByID(child->getID()) != nullptr) {
+            bool overlapped = false;
+            auto topLevel = win;
+            while (auto parent = topLevel->getParent()) {
+                topLevel = parent;
+            }
+            _getSpatialIndex().forEachCandidateReverse(rect, true,
+                [&](const SpatialIndex::Entry& entry)
+            {
+                if (entry.win == topLevel || entry.win->getZOrder() < topLevel->getZOrder()) {
+                    return false;
+                }
+                if (!entry.rect.getIntersection(rect).empty()) {
+                    overlapped = true;
+                    return false;
+                }
+                return true;
+            });
+            return overlapped;
+        }
+
+# if defined(EWM_ADAFRUIT_RA8875) && !defined(EWM_SHARED_FRAMEBUFFER)
+        // Has the controller move what's on the panel for top-level window `win` from
+        // `oldRect` to where the window is now (at the start of the next frame), so
+        // that none of it has to be flushed again; only what the move uncovers is
+        // marked dirty. Possible only if everything the window last drew has been
+        // flushed, and no window above it overlaps either rect. Returns false, having
+        // done nothing, if not.
+        bool blitWindow(const WindowPtr& win, const Rect& oldRect)
+        {
+            EWM_ASSERT(win && !win->getParent());
+            const auto newRect     = win->getRect();
+            const auto displayRect = getDisplayRect();
+            if (bitsHigh(getState(), WMState::SSaverActive) || _gfxDisplay->getRotation() != 0 ||
+                win->isDirty() || !win->getDirtyRegion().empty() ||
+                !oldRect.withinRect(displayRect) || !newRect.withinRect(displayRect) ||
+                isRectOverlappedFromAbove(win, oldRect) || isRectOverlappedFromAbove(win, newRect)) {
                 return false;
             }
-            uint8_t zOrder = 0;
-            if (auto last = _children.rbegin(); last != _children.rend()) {
-                zOrder = (*last)->getZOrder() + 1;
+            if (!_flushPipeline.queueBlit(oldRect, newRect.left - oldRect.left,
+                newRect.top - oldRect.top)) {
+                return false;
             }
-            child->setZOrder(zOrder);
-            _children.push_back(child);
+            Region exposed(oldRect);
+            exposed.subtract(newRect);
+            for (const auto& rect : exposed) {
+                setDirtyRect(rect);
+            }
+            requestRender();
+            EWM_LOG_V("queued blit of %s from {%hd, %hd}", win->toString().c_str(),
+                oldRect.left, oldRect.top);
             return true;
         }
+# endif
 
-        bool removeChildByID(WindowID id) override
+        virtual void setDirtyRect(const Rect& rect)
         {
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
+            _getSpatialIndex().forEachCandidate(rect, true, [=](const SpatialIndex::Entry& entry)
+            {
+                const auto& win = entry.win;
+                if (win->getRect().intersectsRect(rect)) {
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                    // Whatever was in the shared frame buffer here no longer
+                    // belongs to this window.
+                    win->setState(win->getState() | State::Stale);
 # endif
-            for (auto it = _children.begin(); it != _children.end(); it++) {
-                if (id == (*it)->getID()) {
-                    _children.erase(it);
-                    recalculateZOrder();
-                    return true;
+                    const auto intersection = win->getRect().getIntersection(rect);
+                    EWM_LOG_V("dirty rect = {%hd, %hd, %hd, %hd}, intersection"
+                        " with %s is {%hd, %hd, %hd, %hd}", rect.left, rect.top, rect.right, rect.bottom,
+                        win->toString().c_str(), intersection.left, intersection.top, intersection.right,
+                        intersection.bottom);
+                    win->markRectDirty(intersection);
                 }
+                return true;
+            });
+        }
+
+# if defined(EWM_SHARED_FRAMEBUFFER)
+        GfxContextPtr getSharedGfxContext() const noexcept { return _sharedCtx; }
+
+        // Called after `win` has drawn into `rect` of the shared frame buffer: any
+        // top-level windows above it that overlap `rect` must redraw themselves
+        // in full before their pixels are flushed again.
+        void markWindowsAboveStale(const WindowPtr& win, const Rect& rect)
+        {
+            auto topLevel = win;
+            while (auto parent = topLevel->getParent()) {
+                topLevel = parent;
+            }
+            _getSpatialIndex().forEachCandidateReverse(rect, true,
+                [&](const SpatialIndex::Entry& entry)
+            {
+                const auto& above = entry.win;
+                if (above == topLevel || above->getZOrder() < topLevel->getZOrder()) {
+                    return false;
+                }
+                if (above->getRect().intersectsRect(rect)) {
+                    above->setState(above->getState() | State::Stale);
+                }
+                return true;
+            });
+        }
+# endif
+
+        bool displayToWindow(const WindowPtr& win, Point& pt) const
+        {
+            const auto windowRect = win->getRect();
+            if (windowRect.pointWithin(pt.x, pt.y)) {
+                pt.x = pt.x - windowRect.left;
+                pt.y = pt.y - windowRect.top;
+                return true;
+            }
+            return false;
+        }
+
+        bool windowToDisplay(const WindowPtr& win, Point& pt) const
+        {
+            const auto windowRect = win->getRect();
+            const Rect clientRect(0, 0, windowRect.width(), windowRect.height());
+            if (clientRect.pointWithin(pt.x, pt.y)) {
+                pt.x = pt.x + windowRect.left;
+                pt.y = pt.y + windowRect.top;
+                return true;
+            }
+            return false;
+        }
+
+        bool displayToWindow(const WindowPtr& win, Rect& rect) const
+        {
+            Point topLeft(rect.left, rect.top);
+            Point bottomRight(rect.right, rect.bottom);
+            if (displayToWindow(win, topLeft) && displayToWindow(win, bottomRight)) {
+                rect.left   = topLeft.x;
+                rect.top    = topLeft.y;
+                rect.right  = bottomRight.x;
+                rect.bottom = bottomRight.y;
+                return true;
             }
             return false;
         }
 
-        void removeAllChildren() override
+        bool windowToDisplay(const WindowPtr& win, Rect& rect) const
         {
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
-# endif
-            _children.clear();
+            Point topLeft(rect.left, rect.top);
+            Point bottomRight(rect.right, rect.bottom);
+            if (windowToDisplay(win, topLeft) && windowToDisplay(win, bottomRight)) {
+                rect.left   = topLeft.x;
+                rect.top    = topLeft.y;
+                rect.right  = bottomRight.x;
+                rect.bottom = bottomRight.y;
+                return true;
+            }
+            return false;
         }
 
-        void forEachChild(const std::function<bool(const WindowPtr&)>& cb) override
+        virtual void render()
         {
-            if (!cb) {
+# if !defined(EWM_NOMUTEXES) && defined(EWM_SINGLE_TREE_LOCK)
+            ScopeLock treeLock(getTreeMutex());
+# endif
+            _processPostedInput();
+            if (_updateDepth > 0U || !isFrameDue()) {
+# if !defined(EWM_NORENDERSTATS)
+                _renderStats.countIdle();
+# endif
                 return;
             }
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
+            _beginFrame();
+# if !defined(EWM_NORENDERSTATS)
+            const auto beginTime = micros();
+            _frameStats = RenderStats::Frame();
+            _frameStats.timestamp = millis();
 # endif
-            for (auto child : _children) {
-                if (!cb(child)) {
-                    break;
+            _runTimers();
+            bool updated = false;
+            if (bitsHigh(getState(), WMState::SSaverEnabled)) {
+                if (millis() - _ssLastActivity >= _ssTimerMsec) {
+                    if (!bitsHigh(getState(), WMState::SSaverActive)) {
+                        setState(getState() | WMState::SSaverActive);
+                        EWM_LOG_D("activated screensaver");
+                    }
+                } else {
+                    if (bitsHigh(getState(), WMState::SSaverActive)) {
+                        setState(getState() & ~(WMState::SSaverActive | WMState::SSaverDrawn));
+                        setDirtyRect(getDisplayRect());
+                        EWM_LOG_D("de-activated screensaver");
+                    }
+                }
+            }
+            if (bitsHigh(getState(), WMState::SSaverActive)) {
+                if (!bitsHigh(getState(), WMState::SSaverDrawn)) {
+                    _syncFrame();
+# if !defined(EWM_NORENDERSTATS)
+                    const auto flushBegin = micros();
+                    _theme->drawScreensaver(_gfxDisplay);
+                    _frameStats.flushMicros += micros() - flushBegin;
+                    _frameStats.pixels += getDisplayWidth() * getDisplayHeight();
+                    _frameStats.rects++;
+# else
+                    _theme->drawScreensaver(_gfxDisplay);
+# endif
+                    updated = true;
+                    setState(getState() | WMState::SSaverDrawn);
+# if defined(EWM_DAMAGE_DEBUG)
+                    _overlayRegion.clear();
+# endif
+                }
+            } else {
+                // Messages are processed for every window before anything is
+                // composed or flushed, so that handlers (which may call into user
+                // code) never run while a display transaction is open. Handlers may
+                // also reorder the registry (e.g. by showing a window), so it is
+                // walked by copy here rather than visited in place.
+                _registry->forEachChild([&](const WindowPtr& win)
+                {
+                    while (win->processQueue()) { }
+                    return true;
+                });
+# if defined(EWM_NOMUTEXES)
+                // Whatever the handlers just asked for is taken care of by this frame.
+                // (Were other threads able to queue messages, one arriving just now
+                // could be left unnoticed until the next request.)
+                _renderRequested.store(false, std::memory_order_relaxed);
+# endif
+# if defined(EWM_ADAFRUIT_RA8875)
+                if (_flushPipeline.hasPendingBlits()) {
+                    _syncFrame();
+#  if !defined(EWM_NORENDERSTATS)
+                    const auto blitBegin = micros();
+                    _flushPipeline.runBlits();
+                    _frameStats.flushMicros += micros() - blitBegin;
+#  else
+                    _flushPipeline.runBlits();
+#  endif
+                    updated = true;
                 }
+# endif
+                _registry->visitChildren([&](const WindowPtr& win)
+                {
+                    if (!win->isDrawable()) {
+                        return true;
+                    }
+# if !defined(EWM_NORENDERSTATS)
+                    _frameStats.windows++;
+# endif
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                    // A stale window is redrawn in full before its dirty rect is read,
+                    // so that anything its children repaint along the way is flushed.
+                    const bool stale = bitsHigh(win->getState(), State::Stale);
+                    if (stale && !win->getDirtyRegion().empty()) {
+                        win->redraw(true);
+                    }
+# endif
+                    if (win->getDirtyRegion().empty()) {
+                        return true;
+                    }
+                    // Each dirty rect is flushed separately, less the parts of it
+                    // covered by any window above this one.
+                    _collectOccluders(win, win->getDirtyRect());
+                    auto dirtyRegion = win->getDirtyRegion();
+                    dirtyRegion.intersect(getDisplayRect());
+                    // Nothing has drawn into a Composed window since it was moved or
+                    // scrolled (see Window::moveBy()), so its pixels are flushed as is.
+                    const bool composed = bitsHigh(win->getState(), State::Composed);
+                    win->setState(win->getState() & ~(State::Composed | State::Undrawn));
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                    const bool redrawChildren = !stale && !composed;
+# else
+                    const bool redrawChildren = !composed;
+# endif
+                    if (_flushVisible(win, dirtyRegion, 0U, redrawChildren) == 0U) {
+                        EWM_LOG_V("%s is entirely obscured; clearing dirty rect",
+                            win->toString().c_str());
+                        win->markRectDirty(Rect());
+                        win->setDirty(false);
+                        return true;
+                    }
+                    win->markRectDirty(Rect());
+                    win->setDirty(false);
+                    updated = true;
+                    return true;
+                });
+# if defined(EWM_DAMAGE_DEBUG)
+                _restoreDamageOverlay();
+# endif
+# if !defined(EWM_NORENDERSTATS)
+                const auto flushBegin = micros();
+                _flushPipeline.endFrame();
+                _frameStats.flushMicros += micros() - flushBegin;
+# else
+                _flushPipeline.endFrame();
+# endif
+# if defined(EWM_DAMAGE_DEBUG)
+                _drawDamageOverlay();
+# endif
+# if !defined(EWM_SHARED_FRAMEBUFFER)
+                _releaseHiddenContexts();
+# endif
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+                _compressIdleContexts();
+# endif
             }
+            _scheduleTimers();
+# if !defined(EWM_NORENDERSTATS)
+            _recordFrameStats(micros() - beginTime);
+# endif
+# if defined(EWM_DAMAGE_DEBUG)
+            _logDamage();
+# endif
         }
 
-        void forEachChildReverse(const std::function<bool(const WindowPtr&)>& cb) override
+        template<typename... TDisplayArgs>
+        inline bool begin(uint8_t rotation, TDisplayArgs&&... args)
         {
-            if (!cb) {
-                return;
+            bool success = static_cast<bool>(_gfxDisplay);
+            if (success) {
+                /// TODO: possible in C++11 to deduce return type
+                /// of begin() and capture it if it's bool?
+                _gfxDisplay->begin(args...);
+                _gfxDisplay->setRotation(rotation);
+                _gfxDisplay->setCursor(0, 0);
             }
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
+            EWM_ASSERT(success);
+            if (success) {
+                _theme->setDisplayExtents(getDisplayWidth(), getDisplayHeight());
+                _spatialIndex.setBounds(getDisplayWidth(), getDisplayHeight());
+                _flushPipeline.begin(_gfxDisplay);
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                _sharedCtx = createGfxContext(getDisplayWidth(), getDisplayHeight());
+                success = _sharedCtx && getGfxBuffer(_sharedCtx) != nullptr;
+                EWM_ASSERT(success);
+                EWM_LOG_V("created %hux%hu shared gfx context", getDisplayWidth(),
+                    getDisplayHeight());
 # endif
-            for (auto it = _children.rbegin(); it != _children.rend(); it++) {
-                if (!cb((*it))) {
-                    break;
-                }
+                EWM_LOG_D("display: %hux%hu, rotation: %hhu", getDisplayWidth(),
+                    getDisplayHeight(), rotation);
             }
+            return success;
         }
 
     private:
-        WindowDeque _children;
-# if !defined(EWM_NOMUTEXES)
-        Mutex _childMtx;
-# endif
-    };
-
-    enum class WMState : uint8_t
-    {
-        None          = 0,
-        SSaverEnabled = 1 << 0,
-        SSaverActive  = 1 << 1,
-        SSaverDrawn   = 1 << 2
-    };
-
-    class WindowManager : public std::enable_shared_from_this<WindowManager>
-    {
-    public:
-        struct Config
-        {
-            uint32_t minHitTestIntervalMsec = 0U;
-        };
-
-        static constexpr uint32_t DefaultMinHitTestIntervalMsec = 200U;
-
-        WindowManager() = delete;
-
-        explicit WindowManager(
-            const GfxDisplayPtr& gfxDisplay,
-            const ThemePtr& theme,
-            const Font* defaultFont,
-            const Config* config = nullptr
-        ) : _registry(std::make_shared<WindowContainer>()),
-            _gfxDisplay(gfxDisplay), _theme(theme)
+        template<class TWindow, typename... TArgs>
+        std::shared_ptr<TWindow> _makeWindow(TArgs&&... args)
         {
-            EWM_ASSERT(_registry);
-            EWM_ASSERT(_gfxDisplay);
-            EWM_ASSERT(_theme);
-            _theme->setDefaultFont(defaultFont);
-            if (config != nullptr) {
-                _config = *config;
-            } else {
-                _config.minHitTestIntervalMsec = DefaultMinHitTestIntervalMsec;
+            if (_windowArena) {
+                return std::allocate_shared<TWindow>(ArenaAllocator<TWindow>(_windowArena),
+                    std::forward<TArgs>(args)...);
             }
+            return std::make_shared<TWindow>(std::forward<TArgs>(args)...);
         }
 
-        virtual ~WindowManager()
+        SpatialIndex& _getSpatialIndex()
         {
-            tearDown();
+            if (!_spatialIndex.isValid()) {
+                _spatialIndex.rebuild(*_registry);
+            }
+            return _spatialIndex;
         }
 
-        void setState(WMState state) noexcept { _state = state; }
-        WMState getState() const noexcept { return _state; }
-
-        Config getConfig() const noexcept { return _config; }
-        void setConfig(const Config& config) noexcept { _config = config; }
-
-        void enableScreensaver(uint32_t activateAfterMsec) noexcept
+# if !defined(EWM_SHARED_FRAMEBUFFER)
+        // Releases the gfx contexts of hidden top-level windows, least recently used
+        // first, for as long as those of all top-level windows exceed the budget.
+        void _releaseHiddenContexts()
         {
-            _ssTimerMsec = activateAfterMsec;
-            _ssLastActivity = millis();
-            setState(getState() | WMState::SSaverEnabled);
-            EWM_LOG_D("screensaver enabled (%ums)", activateAfterMsec);
+            if (_config.gfxContextBudget == 0U) {
+                return;
+            }
+            size_t total = 0U;
+            _registry->visitChildren([&](const WindowPtr& win)
+            {
+                total += win->getGfxContextSize();
+                return true;
+            });
+            const auto now = millis();
+            while (total > _config.gfxContextBudget) {
+                WindowPtr lru;
+                _registry->visitChildren([&](const WindowPtr& win)
+                {
+                    if (!win->isVisible() && win->getGfxContextSize() > 0U && (!lru ||
+                        now - win->getGfxContextLastUsed() > now - lru->getGfxContextLastUsed())) {
+                        lru = win;
+                    }
+                    return true;
+                });
+                const auto freed = lru ? lru->releaseGfxContext() : 0U;
+                if (freed == 0U) {
+                    break;
+                }
+                total -= freed;
+            }
         }
 
-        void disableScreensaver() noexcept
-        {
-            EWM_CONST(WMState, flags,
-                WMState::SSaverEnabled | WMState::SSaverActive | WMState::SSaverDrawn);
-            setState(getState() & ~flags);
-            EWM_LOG_D("screensaver disabled");
+# endif
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+        // Compresses the gfx context of each top-level window which is hidden or
+        // entirely covered, and whose context has been idle long enough. A frame is
+        // requested for when the next one will have been, as nothing else might.
+        void _compressIdleContexts()
+        {
+            const uint32_t now = millis();
+            uint32_t wait      = NoDeadline;
+            _registry->visitChildren([&](const WindowPtr& win)
+            {
+                if (!win->isGfxContextCompressible() ||
+                    (win->isVisible() && !isWindowEntirelyCovered(win))) {
+                    return true;
+                }
+                const uint32_t idle = now - win->getGfxContextLastUsed();
+                if (idle >= EWM_COMPRESS_IDLE_MSEC) {
+                    win->compressGfxContext();
+                } else {
+                    wait = min<uint32_t>(wait, EWM_COMPRESS_IDLE_MSEC - idle);
+                }
+                return true;
+            });
+            if (wait != NoDeadline) {
+                requestRenderIn(wait);
+            }
         }
 
-        virtual void tearDown()
+# endif
+        // Collects into _occluders the rects of the top-level windows above `win` which
+        // may overlap `rect`.
+        void _collectOccluders(const WindowPtr& win, const Rect& rect)
         {
-            _registry->forEachChild([](const WindowPtr& child)
+            _occluders.clear();
+            _getSpatialIndex().forEachCandidateReverse(rect, true,
+                [&](const SpatialIndex::Entry& entry)
             {
-                child->destroy();
+                if (entry.win == win || entry.win->getZOrder() < win->getZOrder()) {
+                    return false;
+                }
+                _occluders.push_back(entry.rect);
                 return true;
             });
-            _registry->removeAllChildren();
         }
 
-        ThemePtr getTheme() const { return _theme; }
-
-        Extent getDisplayWidth() const noexcept { return _gfxDisplay->width(); }
-        Extent getDisplayHeight() const noexcept { return _gfxDisplay->height(); }
-
-        Rect getDisplayRect() const noexcept
+        // The top-level window that `win` belongs to (maybe itself); nullptr if it has
+        // been removed from the hierarchy.
+        static WindowPtr _getTopLevel(WindowPtr win)
         {
-            return Rect(0, 0, getDisplayWidth(), getDisplayHeight());
+            while (win && win->getParent()) {
+                win = win->getParent();
+            }
+            return win && bitsHigh(win->getStyle(), Style::TopLevel) ? win : nullptr;
         }
 
-        template<class TWindow>
-        std::shared_ptr<TWindow> createWindow(
-            const WindowPtr& parent,
-            WindowID id,
-            Style style,
-            Coord x,
-            Coord y,
-            Extent width,
-            Extent height,
-            const std::string& text = std::string(),
-            const std::function<bool(const std::shared_ptr<TWindow>&)>& preCreateHook = nullptr
-        )
+        // Flushes the parts of `region` not covered by _occluders[occluder...], and
+        // returns the number of rects flushed. Should the region run out of room
+        // while being carved up, it is split in two and each half carries on alone,
+        // so that no occluded pixels are ever flushed.
+        size_t _flushVisible(const WindowPtr& win, Region region, size_t occluder,
+            bool redrawChildren)
         {
-            if (id == WID_INVALID) {
-                EWM_LOG_E("%hhu is a reserved window ID", WID_INVALID);
-                return nullptr;
-            }
-            if (bitsHigh(style, Style::FullScreen)) {
-                x      = 0;
-                y      = 0;
-                width  = getDisplayWidth();
-                height = getDisplayHeight();
-            }
-            Rect rect(x, y, x + width, y + height);
-# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-            EWM_CONST(size_t, MaxClassName, 32);
-            std::array<char, MaxClassName> demangleBuf;
-            size_t dbufSize    = MaxClassName;
-            int status         = 0;
-            const auto clsName = __cxxabiv1::__cxa_demangle(
-                typeid(TWindow).name(),
-                demangleBuf.data(),
-                &dbufSize,
-                &status
-            );
-            EWM_ASSERT(clsName != nullptr && status == 0);
-            std::shared_ptr<TWindow> win(
-                std::make_shared<TWindow>(
-                    shared_from_this(), parent, id, style, rect, text, clsName
-                )
-            );
-            demangleBuf.fill('\0');
-# else
-            std::shared_ptr<TWindow> win(
-                std::make_shared<TWindow>(
-                    shared_from_this(), parent, id, style, rect, text
-                )
-            );
+# if !defined(EWM_SHARED_FRAMEBUFFER)
+            // Only what lies within the window is in its gfx context.
+            region.intersect(win->getRect());
+# endif
+            for (; occluder < _occluders.size() && !region.empty(); occluder++) {
+                auto carved = region;
+                if (!carved.subtract(_occluders[occluder])) {
+                    auto half = region.split();
+                    return _flushVisible(win, region, occluder, redrawChildren) +
+                        _flushVisible(win, half, occluder, redrawChildren);
+                }
+                region = carved;
+            }
+            region.coalesce();
+            for (const auto& rect : region) {
+                auto clientDirtyRect = rect;
+# if !defined(EWM_SHARED_FRAMEBUFFER)
+                if (!displayToWindow(win, clientDirtyRect)) {
+                    continue;
+                }
 # endif
-            if (bitsHigh(style, Style::Child) && !parent) {
-                EWM_LOG_E("%s: Style::Child && null parent", win->toString().c_str());
-                return nullptr;
+                const auto ctx = win->getGfxContext();
+                if (redrawChildren) {
+                    // Nothing outside of this rect is flushed, so there's no sense in
+                    // the children drawing anything else.
+                    ScopedClipRect clip(ctx, clientDirtyRect);
+                    win->getChildren().visitChildren([&](const WindowPtr& child)
+                    {
+                        if (child->isDrawable() && child->getRect().intersectsRect(rect)) {
+                            child->setDirty(true);
+                            child->redraw();
+# if !defined(EWM_NORENDERSTATS)
+                            _frameStats.windows++;
+# endif
+                        }
+                        return true;
+                    });
+                }
+                _flushRect(ctx, clientDirtyRect, rect);
+                EWM_LOG_V("drew rect {%hd, %hd, %hd, %hd} (client: {%hd, %hd, %hd, %hd}) for %s",
+                    rect.left, rect.top, rect.right, rect.bottom,
+                    clientDirtyRect.left, clientDirtyRect.top, clientDirtyRect.right, clientDirtyRect.bottom,
+                    win->toString().c_str());
             }
-            if (bitsHigh(style, Style::TopLevel) && parent) {
-                EWM_LOG_E("%s: Style::TopLevel && parent", win->toString().c_str());
-                return nullptr;
+            return region.size();
+        }
+
+        void _flushRect(const GfxContextPtr& ctx, const Rect& clientDirtyRect,
+            const Rect& dirtyRect)
+        {
+            EWM_ASSERT(ctx);
+            _syncFrame();
+# if !defined(EWM_NORENDERSTATS)
+            const auto flushBegin = micros();
+# endif
+            _flushPipeline.flushRect(ctx, clientDirtyRect, dirtyRect);
+# if !defined(EWM_NORENDERSTATS)
+            _frameStats.flushMicros += micros() - flushBegin;
+            _frameStats.pixels += static_cast<uint32_t>(dirtyRect.width()) * dirtyRect.height();
+            _frameStats.rects++;
+# endif
+# if defined(EWM_DAMAGE_DEBUG)
+            if (!_restoringOverlay) {
+                _recordDamage(dirtyRect);
             }
-            if (preCreateHook && !preCreateHook(win)) {
-                EWM_LOG_E("%s: pre-create hook failed", win->toString().c_str());
-                return nullptr;
+# endif
+        }
+
+# if defined(EWM_DAMAGE_DEBUG)
+        void _recordDamage(const Rect& rect) noexcept
+        {
+            if (_damageRects < _damageRectLog.size()) {
+                _damageRectLog[_damageRects] = rect;
             }
-            if (!win->routeMessage(Message::Create)) {
-                EWM_LOG_E("%s: Message::Create = false", win->toString().c_str());
-                return nullptr;
+            if (_damageRects < UINT16_MAX) {
+                _damageRects++;
             }
-            bool dupe = parent ? !parent->addChild(win) : !_registry->addChild(win);
-            if (dupe) {
-                EWM_LOG_E("duplicate window ID %hhu (parent: %hhu)",
-                    id, parent ? parent->getID() : WID_INVALID);
-                return nullptr;
+            _damagePixels += static_cast<uint32_t>(rect.width()) * rect.height();
+            if (_damageOverlay == DamageOverlay::Overdraw) {
+                _countOverdraw(rect);
             }
-            if (bitsHigh(win->getStyle(), Style::AutoSize)) {
-                win->routeMessage(Message::Resize);
+        }
+
+        void _countOverdraw(const Rect& rect) noexcept
+        {
+            // _overdraw[n] holds what has been flushed more than n times so far.
+            for (size_t level = _overdraw.size() - 1U; level > 0U; level--) {
+                auto again = _overdraw[level - 1U];
+                again.intersect(rect);
+                _overdraw[level].unite(again);
             }
-            win->markRectDirty(rect);
-            win->redraw();
-            return win;
+            _overdraw[0].unite(rect);
         }
 
-        template<class TPrompt>
-        std::shared_ptr<TPrompt> createPrompt(
-            const WindowPtr& parent,
-            WindowID id,
-            Style style,
-            const std::string& text,
-            const std::deque<typename TPrompt::ButtonInfo>& buttons,
-            const typename TPrompt::ResultCallback& callback
-        )
+        // Flushes again whatever the overlay was drawn over, once it's been on screen
+        // long enough (less what this frame has flushed anyway).
+        void _restoreDamageOverlay()
         {
-            EWM_ASSERT(bitsHigh(style, Style::Prompt));
-            const Extent width = min(
-                _theme->getMetric(MetricID::MaxPromptCX).getExtent(),
-                static_cast<Extent>(
-                    getDisplayWidth() - (_theme->getMetric(MetricID::XPadding).getExtent() * 2)
-                )
-            );
-            const Extent height = min(
-                _theme->getMetric(MetricID::MaxPromptCY).getExtent(),
-                static_cast<Extent>(
-                    getDisplayHeight() - (_theme->getMetric(MetricID::YPadding).getExtent() * 2)
-                )
-            );
-            auto prompt = createWindow<TPrompt>(
-                parent,
-                id,
-                style,
-                (getDisplayWidth() / 2) - (width / 2),
-                (getDisplayHeight() / 2) - (height / 2),
-                width,
-                height,
-                text,
-                [&](const std::shared_ptr<TPrompt>& win)
-                {
-                    for (const auto& btn : buttons) {
-                        if (!win->addButton(btn)) {
-                            return false;
-                        }
-                    }
-                    win->setResultCallback(callback);
+            if (_overlayRegion.empty() ||
+                static_cast<int32_t>(millis() - _overlayDueMsec) < 0) {
+                return;
+            }
+            auto region = _overlayRegion;
+            _overlayRegion.clear();
+            for (auto& level : _overdraw) {
+                level.clear();
+            }
+            // What this frame flushed is already current, and counts toward the next
+            // overlay.
+            for (size_t idx = 0U; idx < min<size_t>(_damageRects, _damageRectLog.size()); idx++) {
+                region.subtract(_damageRectLog[idx]);
+                if (_damageOverlay == DamageOverlay::Overdraw) {
+                    _countOverdraw(_damageRectLog[idx]);
+                }
+            }
+            region.intersect(getDisplayRect());
+            _restoringOverlay = true;
+#  if defined(EWM_SHARED_FRAMEBUFFER)
+            for (const auto& rect : region) {
+                _flushRect(_sharedCtx, rect, rect);
+            }
+#  else
+            _registry->visitChildren([&](const WindowPtr& win)
+            {
+                if (!win->isDrawable()) {
                     return true;
                 }
-            );
-            return prompt;
+                auto visible = region;
+                visible.intersect(win->getRect());
+                if (!visible.empty()) {
+                    _collectOccluders(win, visible.getBounds());
+                    _flushVisible(win, visible, 0U, false);
+                }
+                return true;
+            });
+#  endif
+            _restoringOverlay = false;
         }
 
-        template<class TBar>
-        std::shared_ptr<TBar> createProgressBar(
-            const WindowPtr& parent,
-            WindowID id,
-            Style style,
-            Coord x,
-            Coord y,
-            Extent width,
-            Extent height,
-            ProgressStyle pbarStyle
-        )
+        void _drawDamageOverlay()
         {
-            auto pbar = createWindow<TBar>(
-                parent, id, style, x, y, width, height
-            );
-            if (pbar) {
-                pbar->setProgressBarStyle(pbarStyle);
+            if (_damageOverlay == DamageOverlay::None || _damageRects == 0U) {
+                return;
             }
-            return pbar;
+            // RGB565, as drawn by the graphics library.
+            static constexpr uint16_t OutlineColor = 0xf81fU;
+            static constexpr std::array<uint16_t, 4> OverdrawColors {
+                0x07e0U, 0xffe0U, 0xfd20U, 0xf800U
+            };
+            static_assert(OverdrawColors.size() == std::tuple_size<decltype(_overdraw)>::value);
+            if (_overlayRegion.empty()) {
+                _overlayDueMsec = millis() + EWM_DAMAGE_OVERLAY_MSEC;
+            }
+            _syncFrame();
+            if (_damageOverlay == DamageOverlay::Outline) {
+                for (size_t idx = 0U; idx < min<size_t>(_damageRects, _damageRectLog.size()); idx++) {
+                    const auto& rect = _damageRectLog[idx];
+                    _gfxDisplay->drawRect(rect.left, rect.top, rect.width(), rect.height(),
+                        OutlineColor);
+                    _overlayRegion.unite(Rect(rect.left, rect.top, rect.right, rect.top + 1));
+                    _overlayRegion.unite(Rect(rect.left, rect.bottom - 1, rect.right, rect.bottom));
+                    _overlayRegion.unite(Rect(rect.left, rect.top, rect.left + 1, rect.bottom));
+                    _overlayRegion.unite(Rect(rect.right - 1, rect.top, rect.right, rect.bottom));
+                }
+            } else {
+                // All of it is redrawn, since this frame's flushes drew over some of it.
+                for (size_t level = 0U; level < _overdraw.size(); level++) {
+                    auto band = _overdraw[level];
+                    if (level + 1U < _overdraw.size()) {
+                        band.subtract(_overdraw[level + 1U]);
+                    }
+                    for (const auto& rect : band) {
+                        _gfxDisplay->fillRect(rect.left, rect.top, rect.width(), rect.height(),
+                            OverdrawColors[level]);
+                    }
+                }
+                _overlayRegion.unite(_overdraw[0]);
+            }
+            const auto remaining = static_cast<int32_t>(_overlayDueMsec - millis());
+            requestRenderIn(remaining > 0 ? static_cast<uint32_t>(remaining) : 0U);
         }
 
-        bool setForegroundWindow(const WindowPtr& win)
+        void _logDamage()
         {
-            return _registry->setForegroundWindow(win);
+            if (!_damageLog || _damageRects == 0U) {
+                return;
+            }
+            static constexpr size_t HeaderBytes = 24U;
+            static constexpr size_t RectBytes   = 8U;
+            std::array<uint8_t, HeaderBytes + (RectBytes * EWM_DAMAGE_LOG_RECTS)> record;
+            size_t size = 0U;
+            auto put = [&](uint32_t value, size_t bytes)
+            {
+                for (size_t byte = 0U; byte < bytes; byte++) {
+                    record[size++] = static_cast<uint8_t>(value >> (byte * 8U));
+                }
+            };
+            const auto recorded = min<size_t>(_damageRects, _damageRectLog.size());
+            put('E', 1U);
+            put('D', 1U);
+            put(_damageFrame++, 2U);
+            put(_damageFrameMsec, 4U);
+#  if !defined(EWM_NORENDERSTATS)
+            put(_frameStats.composeMicros, 4U);
+            put(_frameStats.flushMicros, 4U);
+#  else
+            put(0U, 4U);
+            put(0U, 4U);
+#  endif
+            put(_damagePixels, 4U);
+            put(_damageRects, 2U);
+            put(static_cast<uint32_t>(recorded), 2U);
+            for (size_t idx = 0U; idx < recorded; idx++) {
+                const auto& rect = _damageRectLog[idx];
+                put(static_cast<uint16_t>(rect.left), 2U);
+                put(static_cast<uint16_t>(rect.top), 2U);
+                put(static_cast<uint16_t>(rect.right), 2U);
+                put(static_cast<uint16_t>(rect.bottom), 2U);
+            }
+            _damageLog(record.data(), size);
         }
+# endif
 
-        void hitTest(Coord x, Coord y)
+        void _processPostedInput()
         {
-            if (millis() - _lastHitTestTime < _config.minHitTestIntervalMsec) {
-                return;
+            PackagedMessage pm;
+            while (_inputQueue.pop(pm)) {
+                EWM_ASSERT(pm.msg == Message::Input);
+                const auto type = static_cast<InputType>(getMsgParamLoWord(pm.p1));
+                if (type == InputType::Tap) {
+                    hitTest(static_cast<Coord>(getMsgParamHiWord(pm.p2)),
+                        static_cast<Coord>(getMsgParamLoWord(pm.p2)));
+                    continue;
+                }
+                const auto pointer = static_cast<uint8_t>(getMsgParamHiWord(pm.p1));
+                if (type == InputType::Drag) {
+                    // Cleared before the position is read, so that a move posted in
+                    // between queues another marker rather than going unnoticed.
+                    _postedPointers[pointer].movePending.store(false, std::memory_order_release);
+                    pm.p2 = _postedPointers[pointer].position.load(std::memory_order_acquire);
+                }
+                const Point pt(static_cast<Coord>(getMsgParamHiWord(pm.p2)),
+                    static_cast<Coord>(getMsgParamLoWord(pm.p2)));
+                switch (type) {
+                    case InputType::Press: _onPointerDown(pointer, pt); break;
+                    case InputType::Drag: _onPointerMoved(pointer, pt); break;
+                    case InputType::Release: _onPointerUp(pointer, pt); break;
+                    default:
+                        EWM_ASSERT(false);
+                    break;
+                }
             }
-            EWM_ASSERT(x >= 0 && y >= 0);
-            EWM_ASSERT(x <= getDisplayWidth() && y <= getDisplayHeight());
-            EWM_LOG_D("hit test at %hd,%hd", x, y);
+            _checkLongPresses();
+        }
+
+        bool _postTouch(InputType type, uint8_t pointer, MsgParam p2) noexcept
+        {
+            PackagedMessage pm;
+            pm.msg = Message::Input;
+            pm.p1  = makeMsgParam(pointer, static_cast<MsgParamWord>(type));
+            pm.p2  = p2;
+            if (!_inputQueue.push(pm)) {
+                return false;
+            }
+            requestRender();
+            return true;
+        }
+
+        // The window a touch begins on (the topmost, deepest one containing the point)
+        // receives the rest of it, too; nothing else is hit tested until it's over.
+        void _onPointerDown(uint8_t pointer, const Point& pt)
+        {
+            auto& state = _pointers[pointer];
+            state = Pointer();
+            state.down     = true;
+            state.start    = pt;
+            state.last     = pt;
+            state.downMsec = millis();
+# if !defined(EWM_NOMUTEXES) && defined(EWM_SINGLE_TREE_LOCK)
+            ScopeLock treeLock(getTreeMutex());
+# endif
             if (bitsHigh(getState(), WMState::SSaverEnabled)) {
-                _ssLastActivity = millis();
+                _ssLastActivity = state.downMsec;
                 if (bitsHigh(getState(), WMState::SSaverActive)) {
+                    // The next frame dismisses the screensaver; this touch is spent.
+                    requestRender();
                     return;
                 }
             }
-            [[maybe_unused]] bool claimed = false;
-            _registry->forEachChildReverse([&](const WindowPtr& child)
+            _getSpatialIndex().forEachCandidateReverse(Rect(pt.x, pt.y, pt.x, pt.y), false,
+                [&](const SpatialIndex::Entry& entry)
             {
-                if (!child->isDrawable()) {
+                if (!entry.rect.pointWithin(pt.x, pt.y) || !entry.win->isDrawable()) {
                     return true;
                 }
-                EWM_LOG_V("interrogating %s re: hit test at %hd,%hd",
-                    child->toString().c_str(), x, y);
-                InputParams params;
-                params.type = InputType::Tap;
-                params.x    = x;
-                params.y    = y;
-                if (child->processInput(&params)) {
-                    EWM_LOG_V("%s claimed hit test at %hd,%hd",
-                        params.handledBy.c_str(), x, y);
-                    claimed = true;
-                    return false;
-                }
-                return true;
+                state.target = entry.win;
+                return false;
             });
-            if (!claimed) {
-                EWM_LOG_V("hit test at %hd,%hd unclaimed", x, y);
+            if (state.target.expired()) {
+                EWM_LOG_V("press at %hd,%hd hit nothing", pt.x, pt.y);
+                return;
             }
-            _lastHitTestTime = millis();
+            _deliverInput(pointer, InputType::Press, pt);
+            requestRenderIn(_config.longPressMsec);
         }
 
-        bool isWindowEntirelyCovered(const WindowPtr& win)
+        void _onPointerMoved(uint8_t pointer, const Point& pt)
         {
-            bool covered = false;
-            const auto rect = win->getRect();
-            _registry->forEachChildReverse([&](const WindowPtr& other)
-            {
-                if (other == win) {
-                    return false;
+            auto& state = _pointers[pointer];
+            if (!state.down || (pt.x == state.last.x && pt.y == state.last.y)) {
+                return;
+            }
+            if (!state.dragging) {
+                const int32_t dx = pt.x - state.start.x;
+                const int32_t dy = pt.y - state.start.y;
+                const int32_t threshold = _config.dragThresholdPx;
+                if ((dx * dx) + (dy * dy) < threshold * threshold) {
+                    return;
                 }
-                if (!other->isDrawable()) {
-                    return true;
+                state.dragging = true;
+            }
+            state.last = pt;
+            _deliverInput(pointer, InputType::Drag, pt);
+        }
+
+        void _onPointerUp(uint8_t pointer, const Point& pt)
+        {
+            auto& state = _pointers[pointer];
+            if (!state.down) {
+                return;
+            }
+            _onPointerMoved(pointer, pt);
+            state.down = false;
+            if (state.dragging) {
+                const int32_t dx = pt.x - state.start.x;
+                const int32_t dy = pt.y - state.start.y;
+                const auto elapsed = max<uint32_t>(millis() - state.downMsec, 1U);
+                const auto distance = static_cast<uint32_t>(sqrtf(static_cast<float>((dx * dx) + (dy * dy))));
+                if (distance * 1000U / elapsed >= _config.swipeMinPxPerSec) {
+                    const auto direction = abs(dx) >= abs(dy)
+                        ? (dx < 0 ? SwipeDirection::Left : SwipeDirection::Right)
+                        : (dy < 0 ? SwipeDirection::Up : SwipeDirection::Down);
+                    _deliverInput(pointer, InputType::Swipe, pt, direction);
                 }
-                if (rect.withinRect(other->getRect())) {
-                    covered = true;
-                    return false;
+            }
+            _deliverInput(pointer, InputType::Release, pt);
+            if (!state.dragging && !state.longPressed) {
+                auto target = state.target.lock();
+                if (target && target->getRect().pointWithin(pt.x, pt.y)) {
+                    _deliverInput(pointer, InputType::Tap, pt);
                 }
-                return true;
-            });
-            return covered;
+            }
+            state.target.reset();
         }
 
-        virtual void setDirtyRect(const Rect& rect)
+        void _checkLongPresses()
         {
-            _registry->forEachChild([=](const WindowPtr& win)
-            {
-                if (!win->isDrawable()) {
-                    return true;
+            const uint32_t now = millis();
+            for (uint8_t pointer = 0U; pointer < EWM_MAX_POINTERS; pointer++) {
+                auto& state = _pointers[pointer];
+                if (!state.down || state.dragging || state.longPressed || state.target.expired()) {
+                    continue;
                 }
-                if (win->getRect().intersectsRect(rect)) {
-                    const auto intersection = win->getRect().getIntersection(rect);
-                    EWM_LOG_V("dirty rect = {%hd, %hd, %hd, %hd}, intersection"
-                        " with %s is {%hd, %hd, %hd, %hd}", rect.left, rect.top, rect.right, rect.bottom,
-                        win->toString().c_str(), intersection.left, intersection.top, intersection.right,
-                        intersection.bottom);
-                    win->markRectDirty(intersection);
+                if (now - state.downMsec >= _config.longPressMsec) {
+                    state.longPressed = true;
+                    _deliverInput(pointer, InputType::LongPress, state.last);
                 }
-                return true;
-            });
+            }
         }
 
-        bool displayToWindow(const WindowPtr& win, Point& pt) const
+        void _deliverInput(uint8_t pointer, InputType type, const Point& pt,
+            SwipeDirection direction = SwipeDirection::None)
         {
-            const auto windowRect = win->getRect();
-            if (windowRect.pointWithin(pt.x, pt.y)) {
-                pt.x = pt.x - windowRect.left;
-                pt.y = pt.y - windowRect.top;
-                return true;
+            auto target = _pointers[pointer].target.lock();
+            if (!target || !target->isDrawable()) {
+                return;
             }
-            return false;
+            target->queueMessage(Message::Input,
+                makeMsgParam(static_cast<MsgParamWord>((static_cast<uint8_t>(direction) << 8) | pointer),
+                    static_cast<MsgParamWord>(type)),
+                makeMsgParam(static_cast<MsgParamWord>(pt.x), static_cast<MsgParamWord>(pt.y)));
         }
 
-        bool windowToDisplay(const WindowPtr& win, Point& pt) const
+# if defined(EWM_RENDER_TASK)
+        void _wakeRenderTask() noexcept
         {
-            const auto windowRect = win->getRect();
-            const Rect clientRect(0, 0, windowRect.width(), windowRect.height());
-            if (clientRect.pointWithin(pt.x, pt.y)) {
-                pt.x = pt.x + windowRect.left;
-                pt.y = pt.y + windowRect.top;
-                return true;
+            auto task = _renderTask.load(std::memory_order_relaxed);
+            if (task != nullptr && task != xTaskGetCurrentTaskHandle()) {
+                xTaskNotifyGive(task);
             }
-            return false;
         }
 
-        bool displayToWindow(const WindowPtr& win, Rect& rect) const
+        static void _renderTaskProc(void* param)
         {
-            Point topLeft(rect.left, rect.top);
-            Point bottomRight(rect.right, rect.bottom);
-            if (displayToWindow(win, topLeft) && displayToWindow(win, bottomRight)) {
-                rect.left   = topLeft.x;
-                rect.top    = topLeft.y;
-                rect.right  = bottomRight.x;
-                rect.bottom = bottomRight.y;
-                return true;
+            auto wm = static_cast<WindowManager*>(param);
+            while (!wm->_renderTaskStop.load()) {
+                wm->render();
+                uint32_t wait = 0U;
+                {
+                    ScopeLock treeLock(getTreeMutex());
+                    wait = wm->getMsecUntilNextFrame();
+                }
+                if (wait > 0U) {
+                    // Work requested in the meantime has left a notification pending,
+                    // so this returns at once rather than missing it.
+                    ulTaskNotifyTake(pdTRUE, wait == NoDeadline ? portMAX_DELAY
+                        : max(pdMS_TO_TICKS(wait), static_cast<TickType_t>(1)));
+                }
             }
-            return false;
+            wm->_renderTaskExited.store(true);
+            vTaskDelete(nullptr);
         }
+# endif
 
-        bool windowToDisplay(const WindowPtr& win, Rect& rect) const
+        void _beginFrame() noexcept
         {
-            Point topLeft(rect.left, rect.top);
-            Point bottomRight(rect.right, rect.bottom);
-            if (windowToDisplay(win, topLeft) && windowToDisplay(win, bottomRight)) {
-                rect.left   = topLeft.x;
-                rect.top    = topLeft.y;
-                rect.right  = bottomRight.x;
-                rect.bottom = bottomRight.y;
-                return true;
+            _renderRequested.store(false, std::memory_order_relaxed);
+            if (_wakePending && static_cast<int32_t>(millis() - _wakeAtMsec) >= 0) {
+                _wakePending = false;
+            }
+            _lastFrameMicros = micros();
+            _framesBegun     = true;
+            _frameSynced     = false;
+# if defined(EWM_DAMAGE_DEBUG)
+            _damageFrameMsec = millis();
+            _damagePixels    = 0U;
+            _damageRects     = 0U;
+# endif
+        }
+
+        struct Timer
+        {
+            std::weak_ptr<IWindow> win;
+            const IWindow* key     = nullptr; /**< nullptr if unused. */
+            AnimationCallback apply;          /**< Animations only. */
+            uint32_t startMsec     = 0U;
+            uint32_t intervalMsec  = 0U;      /**< Or duration, for animations. */
+            uint32_t dueMsec       = 0U;
+            float from             = 0.0f;
+            float to               = 0.0f;
+            TimerID id             = 0;
+            Easing easing          = Easing::Linear;
+            bool repeat            = false;
+        };
+
+        // Returns the timer `id` of `win`, reset, or else an unused one; nullptr if
+        // there are none left.
+        Timer* _getTimer(const WindowPtr& win, TimerID id) noexcept
+        {
+            EWM_ASSERT(win);
+            Timer* unused = nullptr;
+            for (auto& timer : _timers) {
+                if (timer.key == win.get() && timer.id == id) {
+                    unused = &timer;
+                    break;
+                }
+                if (unused == nullptr && (timer.key == nullptr || timer.win.expired())) {
+                    unused = &timer;
+                }
             }
-            return false;
+            if (unused != nullptr) {
+                *unused     = Timer();
+                unused->win = win;
+                unused->key = win.get();
+                unused->id  = id;
+            }
+            return unused;
         }
 
-        virtual void render()
+        static float _ease(Easing easing, float t) noexcept
         {
-# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-            static constexpr uint32_t reportInterval = 30000U;
-            static uint32_t lastReport = 0;
-            const auto beginTime = micros();
-# endif
-            bool updated = false;
-            if (bitsHigh(getState(), WMState::SSaverEnabled)) {
-                if (millis() - _ssLastActivity >= _ssTimerMsec) {
-                    if (!bitsHigh(getState(), WMState::SSaverActive)) {
-                        setState(getState() | WMState::SSaverActive);
-                        EWM_LOG_D("activated screensaver");
-                    }
-                } else {
-                    if (bitsHigh(getState(), WMState::SSaverActive)) {
-                        setState(getState() & ~(WMState::SSaverActive | WMState::SSaverDrawn));
-                        setDirtyRect(getDisplayRect());
-                        EWM_LOG_D("de-activated screensaver");
-                    }
-                }
+            switch (easing) {
+                case Easing::EaseIn:    return t * t;
+                case Easing::EaseOut:   return t * (2.0f - t);
+                case Easing::EaseInOut: return t < 0.5f ? 2.0f * t * t : (t * (4.0f - (2.0f * t))) - 1.0f;
+                default:                return t;
             }
-            if (bitsHigh(getState(), WMState::SSaverActive)) {
-                if (!bitsHigh(getState(), WMState::SSaverDrawn)) {
-                    _theme->drawScreensaver(_gfxDisplay);
-                    updated = true;
-                    setState(getState() | WMState::SSaverDrawn);
+        }
+
+        // Fires the timers that are due, and steps every animation. Their handlers run
+        // before any messages are processed, so whatever they change is drawn and
+        // flushed in this frame.
+        void _runTimers()
+        {
+            const uint32_t now = millis();
+            for (auto& timer : _timers) {
+                if (timer.key == nullptr) {
+                    continue;
                 }
-            } else {
-                _registry->forEachChild([&](const WindowPtr& win)
-                {
-                    while (win->processQueue()) { }
-                    if (!win->isDrawable()) {
-                        return true;
+                auto win = timer.win.lock();
+                if (!win) {
+                    timer = Timer();
+                    continue;
+                }
+                const auto id = timer.id;
+                if (timer.apply) {
+                    const uint32_t elapsed = now - timer.startMsec;
+                    float t = 1.0f;
+                    bool done = false;
+                    if (elapsed < timer.intervalMsec) {
+                        t = static_cast<float>(elapsed) / timer.intervalMsec;
+                    } else if (timer.repeat && timer.intervalMsec > 0U) {
+                        timer.startMsec = now - (elapsed % timer.intervalMsec);
+                        t = static_cast<float>(now - timer.startMsec) / timer.intervalMsec;
+                    } else {
+                        done = true;
                     }
-                    auto dirtyRect = win->getDirtyRect();
-                    if (dirtyRect.empty()) {
-                        return true;
+                    const float value = timer.from + ((timer.to - timer.from) * _ease(timer.easing, t));
+                    // The callback may well set (or kill) timers of its own.
+                    const auto apply = timer.apply;
+                    if (done) {
+                        timer = Timer();
                     }
-                    bool obscuringRectSet = false;
-                    Rect obscuringRect;
-                    _registry->forEachChildReverse([&](const WindowPtr& above)
-                    {
-                        if (win == above) {
-                            return false;
-                        }
-                        if (!above->isDrawable()) {
-                            return true;
-                        }
-                        const auto aboveRect = above->getRect();
-                        if (!obscuringRectSet) {
-                            obscuringRect = aboveRect;
-                            obscuringRectSet = true;
-                        } else {
-                            obscuringRect.mergeRect(aboveRect);
-                        }
-                        return true;
-                    });
-                    std::queue<Rect> dirtyRects;
-                    if (!obscuringRect.empty()) {
-                        dirtyRects = dirtyRect.subtractRect(obscuringRect);
-                        if (dirtyRects.empty()) {
-                            EWM_LOG_V("%s has no dirty rects left after subtracting the"
-                                " obscuring rect; clearing dirty rect", win->toString().c_str());
-                            win->markRectDirty(Rect());
-                            win->setDirty(false);
-                            return true;
+                    apply(win, value);
+                } else if (static_cast<int32_t>(now - timer.dueMsec) >= 0) {
+                    if (timer.repeat) {
+                        timer.dueMsec += timer.intervalMsec;
+                        if (static_cast<int32_t>(now - timer.dueMsec) >= 0) {
+                            // Fallen behind; there's no catching up.
+                            timer.dueMsec = now + timer.intervalMsec;
                         }
                     } else {
-                        dirtyRects.push(dirtyRect);
+                        timer = Timer();
                     }
+                    win->routeMessage(Message::Timer, id, 0U);
+                }
+            }
+        }
 
-                    while (!dirtyRects.empty()) {
-                        auto clientDirtyRect = dirtyRect = dirtyRects.front();
-                        dirtyRects.pop();
-                        win->forEachChild([=](const WindowPtr& win)
-                        {
-                            if (!win->isDrawable()) {
-                                return true;
-                            }
-                            if (win->getRect().intersectsRect(clientDirtyRect)) {
-                                win->setDirty(true);
-                                win->redraw();
-                                return true;
-                            }
-                            return true;
-                        });
-                        if (!displayToWindow(win, clientDirtyRect)) {
-                            EWM_ASSERT(!"failed to convert display to window coords");
-                            return true;
-                        }
-                        auto ctx = win->getGfxContext();
-# if defined(EWM_GFX_ADAFRUIT)
-#  if !defined(EWM_ADAFRUIT_RA8875)
-                        _gfxDisplay->startWrite();
-                        _gfxDisplay->setAddrWindow(
-                            dirtyRect.left,
-                            dirtyRect.top,
-                            dirtyRect.width(),
-                            dirtyRect.height()
-                        );
-                        for (auto line = clientDirtyRect.top; line < clientDirtyRect.bottom; line++) {
-                            const auto offset = getGfxBuffer(ctx) + (line * ctx->width()) + clientDirtyRect.left;
-                            _gfxDisplay->writePixels(offset, clientDirtyRect.width());
-                        }
-                        _gfxDisplay->endWrite();
-#  else
-                        //_gfxDisplay->graphicsMode();
-                        //_gfxDisplay->startWrite();
-                        Coord row = dirtyRect.top;
-                        for (auto line = clientDirtyRect.top; line < clientDirtyRect.bottom; line++, row++) {
-                            const auto offset = getGfxBuffer(ctx) + (line * ctx->width()) + clientDirtyRect.left;
-                            //for (auto col = dirtyRect.left; col < dirtyRect.right; col++) {
-                            //_gfxDisplay->drawPixels(offset, clientDirtyRect.width(), dirtyRect.left, row);
-                                _gfxDisplay->drawRGBBitmap(
-                                    dirtyRect.left,
-                                    row,
-                                    offset,
-                                    dirtyRect.width(),
-                                    1
-                                );
-                            //}
-                        }
-                        //_gfxDisplay->endWrite();
-#  endif
-# else
-                        /* _gfxDisplay->fillScreen(BLACK);
-                        srand(millis());
-                        auto x = min((int)getDisplayWidth(), rand() % getDisplayWidth());
-                        auto y = max(0, rand() % getDisplayHeight());
-                        _gfxDisplay->fillRect(
-                            x,
-                            y,
-                            getDisplayWidth() - x,
-                            getDisplayHeight() - y,
-                            0xf81f
-                        ); */
-
-                        /*_gfxDisplay->startWrite();
-                        Coord row = dirtyRect.top;
-                        for (auto line = clientDirtyRect.top; line < clientDirtyRect.bottom; line++, row++) {
-                            const auto offset = getGfxBuffer(ctx) + (line * ctx->width()) + clientDirtyRect.left;
-                              _gfxDisplay->draw16bitRGBBitmap(
-                                dirtyRect.left,
-                                row,
-                                offset,
-                                dirtyRect.width(),
-                                1
-                            );
-                            // Coord col = 0;
-
-                            //for (auto tmp = clientDirtyRect.left; tmp < clientDirtyRect.right; tmp++, col++) {
-                            //    _gfxDisplay->drawPixel(dirtyRect.left + col, row, *(offset + col));
-                            //}
-                        }
-                        _gfxDisplay->drawRect(
-                            dirtyRect.left - 1,
-                            dirtyRect.top - 1,
-                            dirtyRect.width() + 1,
-                            dirtyRect.height() + 1,
-                            0xf81f
-                        );
-                        _gfxDisplay->endWrite();
-                        _gfxDisplay->flush();*/
-# endif
-                        EWM_LOG_V("drew rect {%hd, %hd, %hd, %hd} (client: {%hd, %hd, %hd, %hd}) for %s",
-                            dirtyRect.left, dirtyRect.top, dirtyRect.right, dirtyRect.bottom,
-                            clientDirtyRect.left, clientDirtyRect.top, clientDirtyRect.right, clientDirtyRect.bottom,
-                            win->toString().c_str());
-                    }
-                    win->markRectDirty(Rect());
-                    win->setDirty(false);
-                    updated = true;
-                    return true;
-                });
+        // Asks for the next frame in time for the next timer, or at the next frame
+        // slot if anything is animating.
+        void _scheduleTimers() noexcept
+        {
+            const uint32_t now = millis();
+            uint32_t wait      = NoDeadline;
+            for (const auto& timer : _timers) {
+                if (timer.key == nullptr) {
+                    continue;
+                }
+                if (timer.apply) {
+                    wait = 0U;
+                    break;
+                }
+                const auto remaining = static_cast<int32_t>(timer.dueMsec - now);
+                wait = min(wait, static_cast<uint32_t>(max(remaining, static_cast<int32_t>(0))));
             }
-# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-            if (millis() - lastReport > reportInterval) {
-                _renderAccumCount = max(1U, _renderAccumCount);
-                _renderAvg        = _renderAccumTime / _renderAccumCount;
-                _renderAccumTime  = 0U;
-                _renderAccumCount = 0U;
-                EWM_LOG_V("avg. render time: %uμs", _renderAvg);
-                lastReport = millis();
-                return;
+            if (wait == 0U) {
+                requestRender();
+            } else if (wait != NoDeadline) {
+                requestRenderIn(wait);
             }
-            _renderAccumTime += micros() - beginTime;
-            _renderAccumCount++;
-# endif
         }
 
-        template<typename... TDisplayArgs>
-        inline bool begin(uint8_t rotation, TDisplayArgs&&... args)
+        uint32_t _getMsecUntilFrameSlot() const noexcept
         {
-            bool success = _gfxDisplay;
-            if (success) {
-                /// TODO: possible in C++11 to deduce return type
-                /// of begin() and capture it if it's bool?
-                _gfxDisplay->begin(args...);
-                _gfxDisplay->setRotation(rotation);
-                _gfxDisplay->setCursor(0, 0);
+            if (_config.maxFramesPerSec == 0U || !_framesBegun) {
+                return 0U;
             }
-            EWM_ASSERT(success);
-            if (success) {
-                _theme->setDisplayExtents(getDisplayWidth(), getDisplayHeight());
-                EWM_LOG_D("display: %hux%hu, rotation: %hhu", getDisplayWidth(),
-                    getDisplayHeight(), rotation);
+            const uint32_t interval = 1000000U / _config.maxFramesPerSec;
+            const uint32_t elapsed  = micros() - _lastFrameMicros;
+            return elapsed >= interval ? 0U : ((interval - elapsed) + 999U) / 1000U;
+        }
+
+        void _syncFrame()
+        {
+            if (!_frameSynced) {
+                _frameSynced = true;
+                if (_frameSync) {
+                    _frameSync();
+                }
             }
-            return success;
         }
 
-    private:
+# if !defined(EWM_NORENDERSTATS)
+        void _recordFrameStats(uint32_t elapsedMicros)
+        {
+            if (_frameStats.messages == 0U && _frameStats.rects == 0U) {
+                _renderStats.countIdle();
+                return;
+            }
+            _frameStats.composeMicros = elapsedMicros - min(elapsedMicros, _frameStats.flushMicros);
+            _renderStats.record(_frameStats);
+#  if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
+            static constexpr uint32_t reportInterval = 30000U;
+            if (millis() - _lastStatsReport > reportInterval) {
+                const auto summary = _renderStats.summarize();
+                EWM_LOG_V("render time (%zu frames): min %uμs, p50 %uμs, p90 %uμs, p99 %uμs,"
+                    " max %uμs (flush avg. %uμs, %u px)", summary.frames, summary.total.min,
+                    summary.total.p50, summary.total.p90, summary.total.p99, summary.total.max,
+                    summary.flush.mean, summary.meanPixels);
+                _lastStatsReport = millis();
+            }
+#  endif
+        }
+# endif
+
         Config _config;
-        WindowContainerPtr _registry;
+        std::shared_ptr<WindowContainer> _registry;
         GfxDisplayPtr _gfxDisplay;
         ThemePtr _theme;
+        FlushPipeline _flushPipeline;
+# if defined(EWM_SHARED_FRAMEBUFFER)
+        GfxContextPtr _sharedCtx;
+# endif
+        WindowArenaPtr _windowArena;
+        SpatialIndex _spatialIndex;
+        std::vector<Rect> _occluders;
+        std::vector<WindowPtr> _pendingUpdates;
+        uint16_t _updateDepth      = 0U;
         WMState _state             = WMState::None;
         uint32_t _ssLastActivity   = 0U;
         uint32_t _ssTimerMsec      = 0U;
         uint32_t _lastHitTestTime  = 0U;
-# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-        uint32_t _renderAvg        = 0U;
-        uint32_t _flushAvg         = 0U;
-        uint32_t _renderAccumTime  = 0U;
-        uint32_t _renderAccumCount = 0U;
-        uint32_t _flushAccumTime   = 0U;
-        uint32_t _flushAccumCount  = 0U;
+        std::atomic<bool> _renderRequested { true };
+        std::function<void()> _frameSync;
+        uint32_t _lastFrameMicros  = 0U;
+        uint32_t _wakeAtMsec       = 0U;
+        bool _wakePending          = false;
+        bool _framesBegun          = false;
+        bool _frameSynced          = false;
+# if defined(EWM_DAMAGE_DEBUG)
+        DamageLogCallback _damageLog;
+        std::array<Rect, EWM_DAMAGE_LOG_RECTS> _damageRectLog;
+        std::array<Region, 4> _overdraw;
+        Region _overlayRegion;           /**< Drawn over by the overlay; yet to be flushed. */
+        DamageOverlay _damageOverlay     = DamageOverlay::None;
+        uint32_t _overlayDueMsec         = 0U;
+        uint32_t _damageFrameMsec        = 0U;
+        uint32_t _damagePixels           = 0U;
+        uint16_t _damageRects            = 0U;
+        uint16_t _damageFrame            = 0U;
+        bool _restoringOverlay           = false;
+# endif
+        MessageRing<PackagedMessage, EWM_INPUT_QUEUE_LEN> _inputQueue;
+        std::array<Timer, EWM_MAX_TIMERS> _timers;
+
+        // Written by postTouch() (any task).
+        struct PostedPointer
+        {
+            bool down = false;
+            std::atomic<MsgParam> position { 0U };
+            std::atomic<bool> movePending { false };
+        };
+
+        // Gesture state; only touched by the task calling render().
+        struct Pointer
+        {
+            std::weak_ptr<IWindow> target;
+            Point start;
+            Point last;
+            uint32_t downMsec = 0U;
+            bool down         = false;
+            bool dragging     = false;
+            bool longPressed  = false;
+        };
+
+        std::array<PostedPointer, EWM_MAX_POINTERS> _postedPointers;
+        std::array<Pointer, EWM_MAX_POINTERS> _pointers;
+# if defined(EWM_RENDER_TASK)
+        std::atomic<TaskHandle_t> _renderTask { nullptr };
+        std::atomic<bool> _renderTaskStop { false };
+        std::atomic<bool> _renderTaskExited { false };
+# endif
+# if !defined(EWM_NORENDERSTATS)
+        RenderStats _renderStats;
+        RenderStats::Frame _frameStats;
+#  if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
+        uint32_t _lastStatsReport  = 0U;
+#  endif
 # endif
     };
 
     using WindowManagerPtr = std::shared_ptr<WindowManager>;
 
+    // WindowManager::beginUpdate() for as long as it's in scope.
+    class ScopedUpdate
+    {
+    public:
+        explicit ScopedUpdate(const WindowManagerPtr& wm) : _wm(wm)
+        {
+            EWM_ASSERT(_wm);
+            _wm->beginUpdate();
+        }
+
+        ScopedUpdate(const ScopedUpdate&) = delete;
+        ScopedUpdate& operator=(const ScopedUpdate&) = delete;
+
+        ~ScopedUpdate()
+        {
+            _wm->endUpdate();
+        }
+
+    private:
+        WindowManagerPtr _wm;
+    };
+
     template<class TTheme, class TGfxDisplay>
     WindowManagerPtr createWindowManager(
         const std::shared_ptr<TGfxDisplay>& display,
@@ -2148,44 +6386,32 @@ namespace exostra
             WindowID id,
             Style style,
             const Rect& rect,
-            const std::string& text
+            std::string_view text
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
             , const char* className
 # endif
-        ) : _wm(wm), _parent(parent), _rect(rect), _dirtyRect(rect), _text(text),
+        ) : _wm(wm), _parent(parent), _rect(rect), _dirtyRegion(rect), _text(text),
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
             _className(className),
 # endif
             _style(style), _id(id)
         {
             if (bitsHigh(_style, Style::TopLevel) && !parent) {
-# if defined(EWM_GFX_ADAFRUIT)
-                _ctx = std::make_shared<GfxContext>(rect.width(), rect.height());
-# else
-#  pragma message("TODO_if_window_resized_recreate_gfx_ctx")
-                _ctx = std::make_shared<GfxContext>(
-                    rect.width(),
-                    rect.height(),
-                    nullptr,
-                    0,
-                    0
-                );
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                _ctx = wm->getSharedGfxContext();
                 EWM_ASSERT(_ctx);
-                if (_ctx) {
-                    _ctx->begin(GFX_SKIP_OUTPUT_BEGIN);
+                EWM_LOG_V("%s: using shared %hux%hu gfx context",
+                    toString().c_str(), _ctx->width(), _ctx->height());
+# else
+                // A window created hidden goes without a gfx context until it's shown.
+                if (bitsHigh(_style, Style::Visible)) {
+                    _allocGfxContext();
                 }
 # endif
-                EWM_LOG_V("%s: created %hux%hu gfx context",
-                    toString().c_str(), rect.width(), rect.height());
             } else {
+                // Children draw into that of their top-level window (see getGfxContext()).
                 EWM_ASSERT(parent);
-                _ctx = parent->getGfxContext();
-                if (_ctx) {
-                    EWM_LOG_V("%s: using parents' %hux%hu gfx context",
-                        toString().c_str(), _ctx->width(), _ctx->height());
-                }
             }
-            EWM_ASSERT(_ctx && getGfxBuffer(_ctx) != nullptr);
             auto theme = _getTheme();
             EWM_ASSERT(theme);
             _bgColor     = theme->getColor(ColorID::WindowBg);
@@ -2196,6 +6422,7 @@ namespace exostra
 
         virtual ~Window() = default;
 
+        WindowContainer& getChildren() noexcept override { return _children; }
         bool hasChildren() override { return _children.hasChildren(); }
         size_t childCount() override { return _children.childCount(); }
         WindowPtr getChildByID(WindowID id) override { return _children.getChildByID(id); }
@@ -2222,20 +6449,312 @@ namespace exostra
 
         WindowPtr getParent() const override { return _parent; }
 
-        GfxContextPtr getGfxContext() const override { return _ctx; }
+        // Returns the gfx context of the top-level window. One that has none (having
+        // been hidden since it was created, or had its context released) gets a blank
+        // one, which show() redraws in full.
+        GfxContextPtr getGfxContext() const override
+        {
+            if (_parent) {
+                return _parent->getGfxContext();
+            }
+# if !defined(EWM_SHARED_FRAMEBUFFER)
+            if (!_ctx) {
+                _allocGfxContext();
+            }
+#  if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+            if (_ctx && _ctx->isCompressed() && !_ctx->decompress()) {
+                EWM_ASSERT(!"failed to decompress gfx context");
+            }
+#  endif
+            if (_ctx) {
+                _ctx->markUsed();
+            }
+# endif
+            return _ctx;
+        }
+
+        // Whether getGfxContext() would return an existing context, rather than create
+        // one.
+        bool hasGfxContext() const noexcept override
+        {
+            return _parent ? _parent->hasGfxContext() : _ctx != nullptr;
+        }
+
+        // Bytes held by the window's own gfx context (that is, 0 for a child).
+        size_t getGfxContextSize() const noexcept override
+        {
+# if defined(EWM_SHARED_FRAMEBUFFER)
+            return 0U;
+# else
+            return _ctx ? _ctx->getBufferSize() : 0U;
+# endif
+        }
+
+        uint32_t getGfxContextLastUsed() const noexcept override
+        {
+            return _ctx ? _ctx->getLastUsed() : 0U;
+        }
+
+        // Releases the gfx context of a hidden top-level window, and returns the number
+        // of bytes freed. It's recreated (and redrawn) once the window is shown again.
+        size_t releaseGfxContext() override
+        {
+            const auto size = getGfxContextSize();
+            if (size == 0U || isVisible()) {
+                return 0U;
+            }
+            _ctx.reset();
+            EWM_LOG_D("%s: released gfx context (%zu bytes)", toString().c_str(), size);
+            return size;
+        }
+# if defined(EWM_COMPRESS_IDLE_CONTEXTS)
+
+        bool isGfxContextCompressible() const noexcept override
+        {
+            return _ctx && _ctx->isCompressible();
+        }
+
+        size_t compressGfxContext() override
+        {
+            const auto freed = _ctx ? _ctx->compress() : 0U;
+            if (freed != 0U) {
+                EWM_LOG_D("%s: compressed gfx context (%zu bytes freed)",
+                    toString().c_str(), freed);
+            }
+            return freed;
+        }
+# endif
 
         Rect getRect() const noexcept override { return _rect; }
 
+        // Sets the window's rect, and redraws it. Its children stay put, and whatever
+        // it leaves uncovered isn't redrawn, so this is meant for laying out windows not
+        // yet on screen; moveTo() moves one that is.
         void setRect(const Rect& rect) noexcept override
         {
             if (rect != _rect) {
+                [[maybe_unused]] const bool resized = rect.width() != _rect.width() ||
+                    rect.height() != _rect.height();
                 _rect = rect;
+# if !defined(EWM_SHARED_FRAMEBUFFER)
+                // A top-level window's gfx context is recreated at the new size.
+                if (resized && _ctx) {
+                    _ctx.reset();
+                    if (isVisible()) {
+                        _allocGfxContext();
+                    }
+                }
+# endif
+                _getWM()->invalidateSpatialIndex();
                 redrawAsync();
             }
         }
 
+        // Offsets the rects of the window and its children, without drawing anything.
+        void offsetRect(Coord dx, Coord dy) noexcept override
+        {
+            _rect.offset(dx, dy);
+            forEachChild([&](const WindowPtr& child)
+            {
+                child->offsetRect(dx, dy);
+                return true;
+            });
+        }
+
+        // Moves the window, along with its children, so that its top left corner is at
+        // x,y (display coordinates). Pixels already drawn are reused rather than redrawn:
+        // a top-level window's gfx context is flushed as is at the new position, and a
+        // child's pixels are copied within its parent's. Redrawn are only what the move
+        // uncovers, and any siblings above a child where it lands. On an RA8875, an
+        // unobstructed top-level window is moved by the controller itself, and not
+        // flushed at all. In shared frame buffer mode, a top-level window is redrawn,
+        // along with whatever it uncovers.
+        bool moveTo(Coord x, Coord y)
+        {
+            return moveBy(x - _rect.left, y - _rect.top);
+        }
+
+        bool moveBy(Coord dx, Coord dy)
+        {
+            if (dx == 0 && dy == 0) {
+                return false;
+            }
+            auto wm = _getWM();
+            EWM_ASSERT(wm);
+            const auto oldRect   = _rect;
+            const auto oldClient = getClientRect();
+            offsetRect(dx, dy);
+            wm->invalidateSpatialIndex();
+            if (!isDrawable()) {
+                return true;
+            }
+            auto parent = getParent();
+            if (!parent) {
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                wm->setDirtyRect(oldRect);
+                wm->setDirtyRect(_rect);
+# else
+#  if defined(EWM_ADAFRUIT_RA8875)
+                if (wm->blitWindow(shared_from_this(), oldRect)) {
+                    return true;
+                }
+#  endif
+                wm->setDirtyRect(oldRect);
+                // Whatever was dirty is flushed along with the rest of the window; left
+                // as is, it would lie where the window used to be.
+                markRectDirty(Rect());
+                markRectDirty(_rect);
+                _setComposed(true);
+# endif
+                return true;
+            }
+            const auto newClient = getClientRect();
+            const auto self = shared_from_this();
+            const auto ctx  = getGfxContext();
+            // Pixels of any sibling above the window which overlaps its old rect
+            // mustn't be carried along (nor, in a shared frame buffer, those of any
+            // top-level window above), so in that case it's redrawn instead.
+            bool obstructed = false;
+            bool above      = false;
+            parent->getChildren().visitChildren([&](const WindowPtr& sibling)
+            {
+                if (sibling == self) {
+                    above = true;
+                } else if (above && sibling->isDrawable() &&
+                    !sibling->getRect().getIntersection(oldRect).empty()) {
+                    obstructed = true;
+                    return false;
+                }
+                return true;
+            });
+# if defined(EWM_SHARED_FRAMEBUFFER)
+            obstructed = obstructed || wm->isRectOverlappedFromAbove(self, oldRect);
+# endif
+            const bool copied = !obstructed && gfxCopyRect(ctx, oldClient, dx, dy);
+            Region exposed(oldClient);
+            if (copied) {
+                exposed.subtract(newClient);
+            } else {
+                exposed.unite(newClient);
+            }
+            // The parent (and any siblings) redraw where the window was. (Clipped draws
+            // don't disturb the pixels just copied.)
+            for (const auto& rect : exposed) {
+                ScopedClipRect clip(ctx, rect);
+                parent->redraw(true);
+            }
+            if (copied) {
+                above = false;
+                parent->getChildren().visitChildren([&](const WindowPtr& sibling)
+                {
+                    if (sibling == self) {
+                        above = true;
+                    } else if (above && sibling->isDrawable() &&
+                        sibling->getRect().intersectsRect(_rect)) {
+                        ScopedClipRect clip(ctx, newClient);
+                        sibling->redraw(true);
+                    }
+                    return true;
+                });
+            }
+# if defined(EWM_SHARED_FRAMEBUFFER)
+            wm->markWindowsAboveStale(self, oldRect);
+            wm->markWindowsAboveStale(self, _rect);
+# endif
+            parent->markRectDirty(oldRect);
+            parent->markRectDirty(_rect);
+            _setComposed(true);
+            return true;
+        }
+
+        // Scrolls the contents of `rect` (display coordinates; clipped to the window)
+        // by dx,dy, moving its pixels within the gfx context rather than redrawing them,
+        // and redraws only what scrolls into view. All of the window's children move
+        // along; those scrolled out of `rect` are still drawn wherever they end up
+        // (which is redrawn), so hide them as they leave.
+        bool scrollBy(Coord dx, Coord dy, const Rect& rect)
+        {
+            const auto area = rect.getIntersection(_rect);
+            if ((dx == 0 && dy == 0) || area.empty()) {
+                return false;
+            }
+            auto wm = _getWM();
+            EWM_ASSERT(wm);
+            forEachChild([&](const WindowPtr& child)
+            {
+                child->offsetRect(dx, dy);
+                return true;
+            });
+            wm->invalidateSpatialIndex();
+            if (!isDrawable()) {
+                return true;
+            }
+            const auto client = getClientRect();
+            const auto ctx    = getGfxContext();
+            auto clientArea = area;
+            clientArea.offset(client.left - _rect.left, client.top - _rect.top);
+            // What stays within the area once scrolled is copied; the rest is exposed.
+            auto kept = clientArea;
+            kept.offset(-dx, -dy);
+            kept = kept.getIntersection(clientArea);
+# if defined(EWM_SHARED_FRAMEBUFFER)
+            // Whatever a top-level window above has drawn over the area mustn't be
+            // scrolled along with it.
+            const bool obstructed = wm->isRectOverlappedFromAbove(shared_from_this(), area);
+# else
+            const bool obstructed = false;
+# endif
+            const bool copied = !obstructed && !kept.empty() && gfxCopyRect(ctx, kept, dx, dy);
+            Region exposed(clientArea);
+            if (copied) {
+                kept.offset(dx, dy);
+                exposed.subtract(kept);
+            }
+            // Children straddling the edge of the area have moved outside of it, too.
+            Region outside;
+            forEachChild([&](const WindowPtr& child)
+            {
+                auto oldRect = child->getRect();
+                oldRect.offset(-dx, -dy);
+                for (const auto& childRect : {oldRect, child->getRect()}) {
+                    if (child->isDrawable() && !childRect.withinRect(area)) {
+                        outside.unite(childRect.getIntersection(_rect));
+                    }
+                }
+                return true;
+            });
+            outside.subtract(area);
+            for (auto strip : outside) {
+                strip.offset(client.left - _rect.left, client.top - _rect.top);
+                exposed.unite(strip);
+            }
+            for (const auto& strip : exposed) {
+                ScopedClipRect clip(ctx, strip);
+                redraw(true);
+            }
+            outside.unite(area);
+            auto parent = getParent();
+            for (const auto& dirtyRect : outside) {
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                wm->markWindowsAboveStale(shared_from_this(), dirtyRect);
+# endif
+                if (parent) {
+                    parent->markRectDirty(dirtyRect);
+                } else {
+                    markRectDirty(dirtyRect);
+                }
+            }
+            _setComposed(true);
+            return true;
+        }
+
         Rect getClientRect() const noexcept override
         {
+# if defined(EWM_SHARED_FRAMEBUFFER)
+            // The shared frame buffer is display-sized, so client coordinates are
+            // display coordinates.
+            return getRect();
+# else
             auto parent = getParent();
             const auto rect = getRect();
             if (bitsHigh(getStyle(), Style::TopLevel) && !parent) {
@@ -2250,49 +6769,47 @@ namespace exostra
                     (rect.top - parentRect.top) + rect.height()
                 );
             }
+# endif
         }
 
-        Rect getDirtyRect() const noexcept
+        Rect getDirtyRect() const noexcept override
         {
-            return _dirtyRect;
+            return _dirtyRegion.getBounds();
         }
-
-        void markRectDirty(const Rect& rect) noexcept
-        {
-            if (!rect.empty()) {
-                const auto windowRect = getRect();
-                auto updatedRect      = false;
-                if (rect.left >= windowRect.left &&
-                    (rect.left < _dirtyRect.left || _dirtyRect.left == 0)) {
-                    _dirtyRect.left = rect.left;
-                    updatedRect = true;
-                }
-                if (rect.top >= windowRect.top &&
-                    (rect.top < _dirtyRect.top || _dirtyRect.top == 0)) {
-                    _dirtyRect.top = rect.top;
-                    updatedRect = true;
-                }
-                if (rect.right <= windowRect.right && rect.right > _dirtyRect.right) {
-                    _dirtyRect.right = rect.right;
-                    updatedRect = true;
-                }
-                if (rect.bottom <= windowRect.bottom && rect.bottom > _dirtyRect.bottom) {
-                    _dirtyRect.bottom = rect.bottom;
-                    updatedRect = true;
-                }
-                if (updatedRect) {
-                    setDirty(true);
-                    forEachChild([=](const WindowPtr& child)
-                    {
-                        if (rect != child->getRect()) {
-                            child->markRectDirty(_dirtyRect);
-                        }
-                        return true;
-                    });
-                }
-            } else {
-                _dirtyRect = Rect();
+
+        const Region& getDirtyRegion() const noexcept override
+        {
+            return _dirtyRegion;
+        }
+
+        // Marking an empty rect clears the dirty region. Rects are kept separate
+        // unless they overlap or nearly touch, so that scattered updates in the
+        // same frame don't cause everything between them to be flushed.
+        void markRectDirty(const Rect& rect) noexcept override
+        {
+            if (rect.empty()) {
+                _dirtyRegion.clear();
+                return;
+            }
+            const auto dirtyRect = getRect().getIntersection(rect);
+            if (dirtyRect.empty()) {
+                return;
             }
+            _dirtyRegion.mergeRect(dirtyRect, EWM_DIRTY_RECT_SLOP);
+            setDirty(true);
+            if (auto wm = _getWM()) {
+                wm->requestRender();
+            }
+            _children.visitChildren([&](const WindowPtr& child)
+            {
+                if (rect != child->getRect()) {
+                    const auto childRect = child->getRect().getIntersection(dirtyRect);
+                    if (!childRect.empty()) {
+                        child->markRectDirty(childRect);
+                    }
+                }
+                return true;
+            });
         }
 
         Style getStyle() const noexcept override { return _style; }
@@ -2300,6 +6817,9 @@ namespace exostra
         void setStyle(Style style) noexcept override
         {
             if (style != _style) {
+                if (bitsHigh(style, Style::Visible) != bitsHigh(_style, Style::Visible)) {
+                    _getWM()->invalidateSpatialIndex();
+                }
                 _style = style;
                 redrawAsync();
             }
@@ -2313,16 +6833,19 @@ namespace exostra
         State getState() const noexcept override { return _state; }
         void setState(State state) noexcept override { _state = state; }
 
-        std::string getText() const override { return _text; }
+        const WindowText& getText() const noexcept override { return _text; }
 
-        void setText(const std::string& text) override
+        void setText(std::string_view text) override
         {
-            if (text != _text) {
-                _text = text;
+            if (_text.assign(text)) {
                 redrawAsync();
             }
         }
 
+        // Makes room for `length` characters of text up front, so that setText() with
+        // no more than that never allocates (e.g., for a label updated continuously).
+        void reserveText(size_t length) { _text.reserve(length); }
+
         Color getBgColor() const noexcept override { return _bgColor; }
 
         void setBgColor(Color color) noexcept override
@@ -2397,6 +6920,23 @@ namespace exostra
                     }
                     handled = onDraw(p1, p2);
                     setDirty(false);
+                    _setComposed(false);
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                    if (!getParent()) {
+                        setState(getState() & ~State::Stale);
+                    }
+                    {
+                        // Only what's within the clip rect (if any) was overwritten.
+                        auto drawnRect = getRect();
+                        const auto ctx = getGfxContext();
+                        if (ctx && ctx->hasClipRect()) {
+                            drawnRect = drawnRect.getIntersection(ctx->getClipRect());
+                        }
+                        if (!drawnRect.empty()) {
+                            _getWM()->markWindowsAboveStale(shared_from_this(), drawnRect);
+                        }
+                    }
+# endif
                     break;
                 case Message::PostDraw:
                     handled = onPostDraw(p1, p2);
@@ -2410,6 +6950,9 @@ namespace exostra
                 case Message::Resize:
                     dirty = handled = onResize(p1, p2);
                     break;
+                case Message::Timer:
+                    handled = onTimer(p1, p2);
+                    break;
                 default:
                     EWM_ASSERT(false);
                     return false;
@@ -2426,11 +6969,44 @@ namespace exostra
 # if !defined(EWM_NOMUTEXES)
             ScopeLock lock(_queueMtx);
 # endif
-            PackagedMessage pm;
-            pm.msg = msg;
-            pm.p1  = p1;
-            pm.p2  = p2;
-            _queue.push(pm);
+            // A Draw (or Resize) still waiting covers this one too: the window is
+            // drawn (or laid out) according to its state once it's processed, not
+            // as it was when queued. Forcing a redraw is sticky, though.
+            // Likewise, a Drag still waiting is simply brought up to date.
+            PackagedMessage* pending = nullptr;
+            if (msg == Message::Draw || msg == Message::Resize) {
+                pending = _queue.find([=](const PackagedMessage& queued)
+                {
+                    return queued.msg == msg;
+                });
+            } else if (msg == Message::Input &&
+                getMsgParamLoWord(p1) == static_cast<MsgParamWord>(InputType::Drag)) {
+                pending = _queue.find([=](const PackagedMessage& queued)
+                {
+                    return queued.msg == msg && queued.p1 == p1;
+                });
+            }
+            if (pending != nullptr) {
+                if (msg == Message::Draw) {
+                    pending->p1 |= p1;
+                } else {
+                    pending->p1 = p1;
+                    pending->p2 = p2;
+                }
+            } else {
+                PackagedMessage pm;
+                pm.msg = msg;
+                pm.p1  = p1;
+                pm.p2  = p2;
+                if (!_queue.push(pm)) {
+                    EWM_LOG_W("%s: queue full; dropped message %hhu", toString().c_str(),
+                        static_cast<uint8_t>(msg));
+                    return false;
+                }
+            }
+            if (auto wm = _getWM()) {
+                wm->requestRender();
+            }
             return msg == Message::Input &&
                 getMsgParamLoWord(p1) == static_cast<MsgParamWord>(InputType::Tap);
         }
@@ -2440,14 +7016,18 @@ namespace exostra
 # if !defined(EWM_NOMUTEXES)
             ScopeLock lock(_queueMtx);
 # endif
-            if (!_queue.empty()) {
-                auto pm = _queue.front();
-                _queue.pop();
+            // Everything queued as of now is processed; anything the handlers queue
+            // in turn is left for the caller's next pass.
+            PackagedMessage pm;
+            for (auto pending = _queue.size(); pending > 0U && _queue.pop(pm); pending--) {
                 routeMessage(pm.msg, pm.p1, pm.p2);
+                _getWM()->countProcessedMessage();
             }
+            // Children are drained in full; render() only runs when asked to, so
+            // anything left behind here might otherwise wait indefinitely.
             forEachChild([&](const WindowPtr& child)
             {
-                child->processQueue();
+                while (child->processQueue()) { }
                 return true;
             });
             return !_queue.empty();
@@ -2462,7 +7042,7 @@ namespace exostra
                 return false;
             }
             bool handled = false;
-            forEachChildReverse([&](const WindowPtr& child)
+            _children.visitChildrenReverse([&](const WindowPtr& child)
             {
                 handled = child->processInput(params);
                 if (handled) {
@@ -2478,7 +7058,7 @@ namespace exostra
                 );
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
                 if (handled) {
-                    params->handledBy = std::move(toString());
+                    params->handledBy = toString();
                 }
 # endif
             }
@@ -2494,7 +7074,7 @@ namespace exostra
                 ? routeMessage(Message::Draw, force ? 1U : 0U) : false;
             bool childRedrawn = false;
             if (redrawn) {
-                forEachChild([](const WindowPtr& child)
+                _children.visitChildren([](const WindowPtr& child)
                 {
                     child->setDirty(true);
                     return true;
@@ -2507,7 +7087,7 @@ namespace exostra
         bool redrawChildren(bool force = false) override
         {
             bool childRedrawn = false;
-            forEachChild([&](const WindowPtr& child)
+            _children.visitChildren([&](const WindowPtr& child)
             {
                 if (child->isDirty() || force) {
                     if (child->redraw(force)) {
@@ -2522,9 +7102,26 @@ namespace exostra
         void redrawAsync() override
         {
             setDirty(true);
+            auto wm = _getWM();
+            if (wm && wm->isUpdating() && wm->deferRedraw(shared_from_this())) {
+                return;
+            }
             queueMessage(Message::Draw);
         }
 
+        // See WindowManager::setTimer() and killTimer().
+        bool setTimer(TimerID id, uint32_t intervalMsec, bool repeat = true)
+        {
+            auto wm = _getWM();
+            return wm && wm->setTimer(shared_from_this(), id, intervalMsec, repeat);
+        }
+
+        bool killTimer(TimerID id)
+        {
+            auto wm = _getWM();
+            return wm && wm->killTimer(shared_from_this(), id);
+        }
+
         bool hide() noexcept override
         {
             if (!isVisible()) {
@@ -2548,6 +7145,11 @@ namespace exostra
             if (topLevel) {
                 auto wm = _getWM();
                 shown = wm->setForegroundWindow(shared_from_this());
+# if !defined(EWM_SHARED_FRAMEBUFFER)
+                if (!_ctx) {
+                    _allocGfxContext();
+                }
+# endif
             }
             setStyle(getStyle() | Style::Visible);
             markRectDirty(getRect());
@@ -2599,18 +7201,20 @@ namespace exostra
                 return true;
             });
             removeAllChildren();
+            _getWM()->invalidateSpatialIndex();
             return destroyed;
         }
 
-        std::string toString() const override
+        WindowName toString() const override
         {
-            std::string retval;
+            std::array<char, WindowName::InlineCapacity + 1U> buffer;
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-            retval = _className;
+            const char* className = _className.c_str();
+# else
+            const char* className = "";
 # endif
-            retval += " (id: " + std::to_string(getID());
-            retval += ")";
-            return std::move(retval);
+            snprintf(buffer.data(), buffer.size(), "%s (id: %hhu)", className, getID());
+            return WindowName(buffer.data());
         }
 
     protected:
@@ -2636,12 +7240,28 @@ namespace exostra
         {
             auto theme = _getTheme();
             EWM_ASSERT(theme);
-            theme->drawWindowBackground(_ctx, getClientRect(), getCornerRadius(), getBgColor());
+            const auto ctx = getGfxContext();
+            theme->drawWindowBackground(ctx, getClientRect(), getCornerRadius(), getBgColor());
             if (bitsHigh(getStyle(), Style::Frame)) {
-                theme->drawWindowFrame(_ctx, getClientRect(), getCornerRadius(), getFrameColor());
+                theme->drawWindowFrame(ctx, getClientRect(), getCornerRadius(), getFrameColor());
             }
             if (bitsHigh(getStyle(), Style::Shadow)) {
-                theme->drawWindowShadow(_ctx, getClientRect(), getCornerRadius(), getShadowColor());
+# if defined(EWM_SHARED_FRAMEBUFFER)
+                // The shadow lies just outside of the window's rect. A per-window context
+                // clips off whatever falls outside of the top-level window; in the shared
+                // frame buffer, that would bleed into the windows beneath it instead.
+                auto topLevel = getParent();
+                if (topLevel) {
+                    while (topLevel->getParent()) {
+                        topLevel = topLevel->getParent();
+                    }
+                    ScopedClipRect clip(ctx, topLevel->getRect());
+                    theme->drawWindowShadow(ctx, getClientRect(), getCornerRadius(),
+                        getShadowColor());
+                }
+# else
+                theme->drawWindowShadow(ctx, getClientRect(), getCornerRadius(), getShadowColor());
+# endif
             }
             return routeMessage(Message::PostDraw);
         }
@@ -2656,16 +7276,32 @@ namespace exostra
             return true;
         }
 
-        // Message::Input: p1 = (loword: type), p2 = (hiword: x, loword: y).
+        // Message::Input: p1 = (hiword: swipe direction << 8 | pointer, loword: type),
+        // p2 = (hiword: x, loword: y).
         // Returns true if the input event was consumed by this window, false otherwise.
         bool onInput(MsgParam p1, MsgParam p2) override
         {
             InputParams params;
-            params.type = static_cast<InputType>(getMsgParamLoWord(p1));
-            params.x    = getMsgParamHiWord(p2);
-            params.y    = getMsgParamLoWord(p2);
+            params.type      = static_cast<InputType>(getMsgParamLoWord(p1));
+            params.x         = getMsgParamHiWord(p2);
+            params.y         = getMsgParamLoWord(p2);
+            params.pointer   = static_cast<uint8_t>(getMsgParamHiWord(p1) & 0xffU);
+            params.direction = static_cast<SwipeDirection>(getMsgParamHiWord(p1) >> 8);
             switch (params.type) {
                 case InputType::Tap: return onTapped(params.x, params.y);
+                case InputType::Press:
+                    _dragOrigin = Point(params.x, params.y);
+                    return onPressed(params.x, params.y);
+                case InputType::Drag: {
+                    // Drags are coalesced, so the distance covered is measured from
+                    // wherever the last one (or the press) left off.
+                    const auto origin = _dragOrigin;
+                    _dragOrigin = Point(params.x, params.y);
+                    return onDragged(params.x, params.y, params.x - origin.x, params.y - origin.y);
+                }
+                case InputType::Release: return onReleased(params.x, params.y);
+                case InputType::LongPress: return onLongPressed(params.x, params.y);
+                case InputType::Swipe: return onSwiped(params.direction, params.x, params.y);
                 default:
                     EWM_ASSERT(false);
                 break;
@@ -2683,6 +7319,9 @@ namespace exostra
             return false;
         }
 
+        // Message::Timer: p1 = TimerID, p2 = 0.
+        bool onTimer(MsgParam p1, MsgParam p2) override { return false; }
+
         // ====== End message handlers ======
 
         bool onTapped([[maybe_unused]] Coord x, [[maybe_unused]] Coord y) override
@@ -2690,13 +7329,67 @@ namespace exostra
             return false;
         }
 
+        bool onPressed([[maybe_unused]] Coord x, [[maybe_unused]] Coord y) override
+        {
+            return false;
+        }
+
+        // dx,dy: distance travelled since the press, or the previous drag.
+        bool onDragged([[maybe_unused]] Coord x, [[maybe_unused]] Coord y,
+            [[maybe_unused]] Coord dx, [[maybe_unused]] Coord dy) override
+        {
+            return false;
+        }
+
+        bool onReleased([[maybe_unused]] Coord x, [[maybe_unused]] Coord y) override
+        {
+            return false;
+        }
+
+        bool onLongPressed([[maybe_unused]] Coord x, [[maybe_unused]] Coord y) override
+        {
+            return false;
+        }
+
+        bool onSwiped([[maybe_unused]] SwipeDirection direction, [[maybe_unused]] Coord x,
+            [[maybe_unused]] Coord y) override
+        {
+            return false;
+        }
+
         WindowManagerPtr _getWM() const { return _wm; }
 
+        // State::Composed belongs to the top-level window, whose gfx context is shared
+        // by all of its children. It can't be set while changes batched by
+        // WindowManager::endUpdate() are yet to be drawn (State::Undrawn).
+        void _setComposed(bool composed) noexcept
+        {
+            IWindow* topLevel = this;
+            for (auto parent = getParent(); parent; parent = parent->getParent()) {
+                topLevel = parent.get();
+            }
+            if (composed && !bitsHigh(topLevel->getState(), State::Undrawn)) {
+                topLevel->setState(topLevel->getState() | State::Composed);
+            } else {
+                topLevel->setState(topLevel->getState() & ~State::Composed);
+            }
+        }
+
         ThemePtr _getTheme() const
         {
             auto wm = _getWM();
             return wm ? wm->getTheme() : nullptr;
         }
+# if !defined(EWM_SHARED_FRAMEBUFFER)
+
+        void _allocGfxContext() const
+        {
+            _ctx = createGfxContext(_rect.width(), _rect.height());
+            EWM_ASSERT(_ctx && getGfxBuffer(_ctx) != nullptr);
+            EWM_LOG_V("%s: created %hux%hu gfx context", toString().c_str(),
+                _rect.width(), _rect.height());
+        }
+# endif
 
     private:
         WindowContainer _children;
@@ -2706,10 +7399,11 @@ namespace exostra
 # endif
         WindowManagerPtr _wm;
         WindowPtr _parent;
-        GfxContextPtr _ctx;
+        mutable GfxContextPtr _ctx; // Top-level windows only (see getGfxContext()).
         Rect _rect;
-        Rect _dirtyRect;
-        std::string _text;
+        Region _dirtyRegion;
+        Point _dragOrigin;
+        WindowText _text;
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
         std::string _className;
 # endif
@@ -2730,12 +7424,17 @@ namespace exostra
         using Window::Window;
         virtual ~Button() = default;
 
+        /** Released after the theme's ButtonTappedDuration; not for use by subclasses. */
+        static constexpr TimerID PressedTimer = 0xff;
+
         bool onTapped(Coord x, Coord y) override
         {
             auto theme = _getTheme();
             EWM_ASSERT(theme);
             setState(getState() | State::Pressed);
             redrawAsync();
+            setTimer(PressedTimer, theme->getMetric(MetricID::ButtonTappedDuration).getUint32(),
+                false);
             auto parent = getParent();
             EWM_ASSERT(parent);
             if (parent) {
@@ -2759,6 +7458,16 @@ namespace exostra
             return true;
         }
 
+        bool onTimer(MsgParam p1, MsgParam p2) override
+        {
+            if (p1 != PressedTimer) {
+                return Window::onTimer(p1, p2);
+            }
+            setState(getState() & ~State::Pressed);
+            redrawAsync();
+            return true;
+        }
+
         bool onDraw(MsgParam p1, MsgParam p2) override
         {
             auto theme = _getTheme();
@@ -2799,9 +7508,19 @@ namespace exostra
             auto rect = getRect();
             auto theme = _getTheme();
             EWM_ASSERT(theme);
-            auto ctx = getGfxContext();
-            EWM_ASSERT(ctx);
-            ctx->getTextBounds(getText().c_str(), rect.left, rect.top, &x, &y, &width, &height);
+            // A window that's yet to be shown has no gfx context to measure the text
+            // with (nor should it be given one just for that), so the display is used.
+            if (hasGfxContext()) {
+                auto ctx = getGfxContext();
+                EWM_ASSERT(ctx);
+                ctx->getTextBounds(getText().c_str(), rect.left, rect.top, &x, &y, &width,
+                    &height);
+            } else {
+                auto display = _getWM()->getGfxDisplay();
+                EWM_ASSERT(display);
+                display->getTextBounds(getText().c_str(), rect.left, rect.top, &x, &y,
+                    &width, &height);
+            }
             const auto maxWidth = max(width, theme->getMetric(MetricID::DefButtonCX).getExtent());
             rect.right = rect.left + maxWidth +
                 (theme->getMetric(MetricID::ButtonLabelPadding).getExtent() * 2);
@@ -3011,35 +7730,58 @@ namespace exostra
         {
             if (style != _barStyle) {
                 _barStyle = style;
+                _fillStale = true;
                 redrawAsync();
             }
         }
 
         float getProgressValue() const noexcept { return _value; }
 
+        // Only the strip(s) between the old fill and the new are redrawn (and flushed).
         void setProgressValue(float value) noexcept
         {
             if (abs(value) != abs(_value)) {
-                _value = value;
-                redrawAsync();
+                _value     = value;
+                _fillStale = true;
+                setDirty(true);
+                queueMessage(Message::Draw, DrawDelta);
             }
         }
 
+        void redrawAsync() override
+        {
+            _redrawPending = true;
+            Window::redrawAsync();
+        }
+
     protected:
+        /** Message::Draw p1 for a redraw of what changed along with the value. */
+        static constexpr MsgParam DrawDelta = 1U << 1;
+
         bool onDraw(MsgParam p1, MsgParam p2) override
         {
             auto theme = _getTheme();
             EWM_ASSERT(theme);
             auto ctx = getGfxContext();
             EWM_ASSERT(ctx);
-            theme->drawProgressBarBackground(ctx, getClientRect());
-            theme->drawWindowFrame(ctx, getClientRect(), getCornerRadius(), getFrameColor());
+            const auto clientRect = getClientRect();
+            const auto prevFill   = _fillRect;
+            if (_fillStale || clientRect != _drawnRect) {
+                _updateFillRect(theme, clientRect);
+            }
+            // Only the Draw queued by setProgressValue() may be partial; any other
+            // (e.g. the parent having drawn over this bar) calls for a full redraw.
+            if (p1 == DrawDelta && !_redrawPending && clientRect == _drawnRect) {
+                return _drawDelta(theme, ctx, clientRect, prevFill);
+            }
+            _redrawPending = false;
+            _drawnRect     = clientRect;
+            theme->drawProgressBarBackground(ctx, clientRect);
+            theme->drawWindowFrame(ctx, clientRect, getCornerRadius(), getFrameColor());
             bool drawn = false;
-            if (bitsHigh(getProgressBarStyle(), ProgressStyle::Normal)) {
-                theme->drawProgressBarProgress(ctx, getClientRect(), getProgressValue());
-                drawn = true;
-            } else if (bitsHigh(getProgressBarStyle(), ProgressStyle::Indeterminate)) {
-                theme->drawProgressBarIndeterminate(ctx, getClientRect(), getProgressValue());
+            if (bitsHigh(getProgressBarStyle(), ProgressStyle::Normal) ||
+                bitsHigh(getProgressBarStyle(), ProgressStyle::Indeterminate)) {
+                theme->drawProgressBarFill(ctx, _fillRect);
                 drawn = true;
             }
             return drawn ? routeMessage(Message::PostDraw) : false;
@@ -3048,6 +7790,49 @@ namespace exostra
     private:
         ProgressStyle _barStyle = ProgressStyle::Normal;
         float _value            = 0.0f;
+        Rect _fillRect;               /**< Client coordinates. */
+        Rect _drawnRect;              /**< Client rect as of the last full redraw. */
+        Coord _marqueeStep   = -1;
+        bool _fillStale      = true;
+        bool _redrawPending  = true;
+
+        void _updateFillRect(const ThemePtr& theme, const Rect& clientRect)
+        {
+            if (bitsHigh(getProgressBarStyle(), ProgressStyle::Normal)) {
+                _fillRect = theme->getProgressBarProgressRect(clientRect, getProgressValue());
+            } else if (bitsHigh(getProgressBarStyle(), ProgressStyle::Indeterminate)) {
+                _fillRect = theme->getProgressBarMarqueeRect(clientRect, getProgressValue(),
+                    _marqueeStep);
+            } else {
+                _fillRect = Rect();
+            }
+            _fillStale = false;
+        }
+
+        bool _drawDelta(const ThemePtr& theme, const GfxContextPtr& ctx,
+            const Rect& clientRect, const Rect& prevFill)
+        {
+            Region changed(prevFill);
+            changed.unite(_fillRect);
+            changed.subtract(prevFill.getIntersection(_fillRect));
+            auto parent = getParent();
+            const auto rect = getRect();
+            for (const auto& strip : changed) {
+                {
+                    ScopedClipRect clip(ctx, strip);
+                    theme->drawProgressBarBackground(ctx, clientRect);
+                    theme->drawWindowFrame(ctx, clientRect, getCornerRadius(), getFrameColor());
+                    theme->drawProgressBarFill(ctx, _fillRect);
+                }
+                if (parent) {
+                    const Coord dx = rect.left - clientRect.left;
+                    const Coord dy = rect.top - clientRect.top;
+                    parent->markRectDirty(Rect(strip.left + dx, strip.top + dy,
+                        strip.right + dx, strip.bottom + dy));
+                }
+            }
+            return true;
+        }
     };
 
     class CheckBox : public Window
@@ -3090,6 +7875,392 @@ namespace exostra
             return true;
         }
     };
+
+    /**
+     * A position or extent of a window described by a StaticScreen, in terms of the
+     * theme: `count` times a metric (an Extent), plus `px` pixels scaled to the display,
+     * added to what `ref` names. See the helpers in exostra::layout.
+     */
+    struct LayoutDim
+    {
+        enum class Ref : uint8_t
+        {
+            None    = 0, /**< Nothing; the value is a display coordinate, or an extent. */
+            Parent  = 1, /**< The parent's left/top edge, or its width/height. */
+            Prev    = 2, /**< The previous sibling's left/top edge, or its width/height. */
+            PrevEnd = 3  /**< The previous sibling's right/bottom edge. */
+        };
+
+        Ref ref         = Ref::None;
+        MetricID metric = static_cast<MetricID>(0); /**< 0 = none. */
+        int8_t count    = 0;
+        int16_t px      = 0;
+    };
+
+    namespace layout
+    {
+        constexpr LayoutDim px(int16_t px) noexcept
+        {
+            return LayoutDim { LayoutDim::Ref::None, static_cast<MetricID>(0), 0, px };
+        }
+
+        constexpr LayoutDim metric(MetricID metric, int8_t count = 1, int16_t px = 0) noexcept
+        {
+            return LayoutDim { LayoutDim::Ref::None, metric, count, px };
+        }
+
+        constexpr LayoutDim relativeTo(LayoutDim::Ref ref, LayoutDim dim) noexcept
+        {
+            dim.ref = ref;
+            return dim;
+        }
+
+        // e.g. parent(metric(MetricID::XPadding)): inset from the parent's edge by one
+        // padding; for a width, parent(metric(MetricID::XPadding, -2)) fills the parent
+        // less a padding on either side.
+        constexpr LayoutDim parent(LayoutDim dim = LayoutDim()) noexcept
+        {
+            return relativeTo(LayoutDim::Ref::Parent, dim);
+        }
+
+        constexpr LayoutDim prev(LayoutDim dim = LayoutDim()) noexcept
+        {
+            return relativeTo(LayoutDim::Ref::Prev, dim);
+        }
+
+        constexpr LayoutDim after(LayoutDim dim = LayoutDim()) noexcept
+        {
+            return relativeTo(LayoutDim::Ref::PrevEnd, dim);
+        }
+    } // namespace layout
+
+    struct WindowSpec
+    {
+        WindowID id       = WID_INVALID;
+        WindowID parentID = WID_INVALID; /**< WID_INVALID = top-level window. */
+        Style style       = Style::None;
+        LayoutDim x, y, width, height;
+        const char* text  = nullptr;
+    };
+
+    template<class TWindow>
+    struct StaticWindow
+    {
+        using Type = TWindow;
+        WindowSpec spec;
+    };
+
+    /**
+     * A screen whose windows are all known at compile time, described (constexpr) by
+     * one StaticWindow per window, parents before their children:
+     *
+     *   using namespace exostra::layout;
+     *   static StaticScreen<DefaultWindow, Button, Label> screen(
+     *     StaticWindow<DefaultWindow> {{ 1, WID_INVALID, Style::TopLevel | Style::Visible,
+     *       parent(metric(MetricID::XPadding)), parent(metric(MetricID::XPadding)),
+     *       parent(metric(MetricID::XPadding, -2)), parent(metric(MetricID::XPadding, -2)) }},
+     *     StaticWindow<Button> {{ 2, 1, Style::Button | Style::Child | Style::Visible
+     *       | Style::AutoSize, parent(metric(MetricID::XPadding)),
+     *       parent(metric(MetricID::YPadding)), px(0), px(0), "Button" }},
+     *     StaticWindow<Label> {{ 3, 1, Style::Label | Style::Child | Style::Visible,
+     *       after(metric(MetricID::XPadding)), prev(), prev(), metric(MetricID::DefButtonCY),
+     *       "Label" }}
+     *   );
+     *   screen.create(wm);
+     *   auto label = screen.get<2>(); // std::shared_ptr<Label>
+     *
+     * The windows (and their control blocks) are placed in storage inside the screen
+     * object itself, sized for exactly these types, rather than on the heap; a screen
+     * at namespace scope therefore lives in .bss. The screen must outlive its windows.
+     */
+    template<class... TWindows>
+    class StaticScreen
+    {
+    public:
+        static constexpr size_t Count = sizeof...(TWindows);
+
+        template<size_t I>
+        using WindowType = std::tuple_element_t<I, std::tuple<TWindows...>>;
+
+        explicit StaticScreen(const StaticWindow<TWindows>&... windows) noexcept
+            : _specs { windows.spec... } { }
+
+        StaticScreen(const StaticScreen&) = delete;
+        StaticScreen& operator=(const StaticScreen&) = delete;
+
+        // Creates every window, in order. If any fails, those created so far are
+        // destroyed again and false is returned.
+        bool create(const WindowManagerPtr& wm)
+        {
+            EWM_ASSERT(wm);
+            EWM_ASSERT(!_windows[0]);
+            const auto prevArena = wm->getWindowArena();
+            // Non-owning; the arena is part of this object.
+            wm->setWindowArena(WindowArenaPtr(WindowArenaPtr(), &_arena));
+            const bool created = _createAll(wm, std::index_sequence_for<TWindows...>());
+            wm->setWindowArena(prevArena);
+            if (!created) {
+                destroy(wm);
+            }
+            return created;
+        }
+
+        // Destroys every window of the screen; their storage is free for reuse once
+        // nothing else holds on to them.
+        void destroy(const WindowManagerPtr& wm)
+        {
+            for (size_t i = 0U; i < Count; i++) {
+                if (_windows[i] && _specs[i].parentID == WID_INVALID) {
+                    wm->destroyWindow(_windows[i]);
+                }
+            }
+            _windows.fill(nullptr);
+        }
+
+        template<size_t I>
+        std::shared_ptr<WindowType<I>> get() const noexcept
+        {
+            return std::static_pointer_cast<WindowType<I>>(_windows[I]);
+        }
+
+        const WindowArena& getArena() const noexcept { return _arena; }
+
+    private:
+        template<size_t... I>
+        bool _createAll(const WindowManagerPtr& wm, std::index_sequence<I...>)
+        {
+            return (_create<I>(wm) && ...);
+        }
+
+        template<size_t I>
+        bool _create(const WindowManagerPtr& wm)
+        {
+            const auto& spec = _specs[I];
+            WindowPtr parent;
+            WindowPtr prev;
+            for (size_t i = 0U; i < I; i++) {
+                if (_specs[i].id == spec.parentID) {
+                    parent = _windows[i];
+                } else if (_specs[i].parentID == spec.parentID) {
+                    prev = _windows[i];
+                }
+            }
+            if (spec.parentID != WID_INVALID && !parent) {
+                EWM_LOG_E("parent %hhu of window %hhu not created before it", spec.parentID,
+                    spec.id);
+                return false;
+            }
+            const auto theme      = wm->getTheme();
+            const auto parentRect = parent ? parent->getRect() : wm->getDisplayRect();
+            const auto prevRect   = prev ? prev->getRect() : parentRect;
+            auto resolve = [&](const LayoutDim& dim, Coord parentVal, Coord prevVal,
+                Coord prevEndVal) -> Coord
+            {
+                Coord value = 0;
+                if (static_cast<uint8_t>(dim.metric) != 0U) {
+                    value += dim.count * static_cast<Coord>(
+                        theme->getMetric(dim.metric).getExtent());
+                }
+                const auto scaled = static_cast<Coord>(
+                    theme->getScaledValue(static_cast<Extent>(abs(dim.px))));
+                value += dim.px < 0 ? -scaled : scaled;
+                switch (dim.ref) {
+                    case LayoutDim::Ref::Parent:  return parentVal + value;
+                    case LayoutDim::Ref::Prev:    return prevVal + value;
+                    case LayoutDim::Ref::PrevEnd: return prevEndVal + value;
+                    default:                      return value;
+                }
+            };
+            auto win = wm->createWindow<WindowType<I>>(
+                parent,
+                spec.id,
+                spec.style,
+                resolve(spec.x, parentRect.left, prevRect.left, prevRect.right),
+                resolve(spec.y, parentRect.top, prevRect.top, prevRect.bottom),
+                static_cast<Extent>(resolve(spec.width, parentRect.width(),
+                    prevRect.width(), prevRect.width())),
+                static_cast<Extent>(resolve(spec.height, parentRect.height(),
+                    prevRect.height(), prevRect.height())),
+                spec.text != nullptr ? std::string_view(spec.text) : std::string_view()
+            );
+            _windows[I] = win;
+            return win != nullptr;
+        }
+
+        // Room for each window and its shared_ptr control block (which also holds the
+        // allocator, and so a WindowArenaPtr). Should it fall short after all, the
+        // remainder simply comes from the heap.
+        static constexpr size_t StorageBytes = ((sizeof(TWindows) + 4U * sizeof(void*) +
+            sizeof(WindowArenaPtr) + alignof(std::max_align_t)) + ...);
+
+        std::array<WindowSpec, Count> _specs;
+        std::array<WindowPtr, Count> _windows {};
+        alignas(std::max_align_t) uint8_t _storage[StorageBytes] {};
+        WindowArena _arena { _storage, StorageBytes };
+    };
+
+    enum class TouchMapping : uint8_t
+    {
+        None    = 0,
+        SwapXY  = 1 << 0, /**< The controller's X axis runs along the display's Y axis. */
+        MirrorX = 1 << 1, /**< After swapping, the display's X axis runs the other way. */
+        MirrorY = 1 << 2  /**< After swapping, the display's Y axis runs the other way. */
+    };
+
+    /**
+     * Maps the points a touch controller reports, in its own resolution and orientation,
+     * onto the display as it's rotated. Everything which can be is worked out up front;
+     * mapping a point is then a multiply and a shift per axis.
+     */
+    class TouchTransform
+    {
+    public:
+        TouchTransform() = default;
+
+        // rawWidth, rawHeight: the range of the controller's X and Y axes. width, height:
+        // the display's (e.g. WindowManager::getDisplayWidth()/Height()).
+        TouchTransform(Extent rawWidth, Extent rawHeight, Extent width, Extent height,
+            TouchMapping mapping) noexcept
+            : _width(width), _height(height), _mapping(mapping)
+        {
+            EWM_ASSERT(rawWidth > 0 && rawHeight > 0);
+            const bool swap = bitsHigh(mapping, TouchMapping::SwapXY);
+            _xScale = (static_cast<uint32_t>(width) << FracBits) / (swap ? rawHeight : rawWidth);
+            _yScale = (static_cast<uint32_t>(height) << FracBits) / (swap ? rawWidth : rawHeight);
+        }
+
+        Point apply(int32_t rawX, int32_t rawY) const noexcept
+        {
+            if (bitsHigh(_mapping, TouchMapping::SwapXY)) {
+                std::swap(rawX, rawY);
+            }
+            auto x = _scale(rawX, _xScale, _width);
+            auto y = _scale(rawY, _yScale, _height);
+            if (bitsHigh(_mapping, TouchMapping::MirrorX)) {
+                x = _width - 1 - x;
+            }
+            if (bitsHigh(_mapping, TouchMapping::MirrorY)) {
+                y = _height - 1 - y;
+            }
+            return Point(x, y);
+        }
+
+    private:
+        static constexpr uint8_t FracBits = 16U;
+
+        static Coord _scale(int32_t raw, uint32_t scale, Extent range) noexcept
+        {
+            const auto value = static_cast<int32_t>((static_cast<int64_t>(raw) * scale) >> FracBits);
+            return static_cast<Coord>(std::clamp<int32_t>(value, 0, range - 1));
+        }
+
+        uint32_t _xScale      = 1U << FracBits;
+        uint32_t _yScale      = 1U << FracBits;
+        Extent _width         = 1;
+        Extent _height        = 1;
+        TouchMapping _mapping = TouchMapping::None;
+    };
+
+# if defined(ESP32)
+    /**
+     * Reads a capacitive touch controller (Adafruit_FT6206, Adafruit_FT5336,
+     * Adafruit_CST8XX, or anything else with touched() and getPoint(n)) and hands the
+     * points it reports, mapped by a TouchTransform, to WindowManager::postTouch().
+     *
+     * Given the controller's interrupt line, the bus is left alone until the controller
+     * raises it (and, while a touch is in progress, every EWM_TOUCH_POLL_MSEC), rather
+     * than being read every time around the loop. The interrupt handler itself only
+     * takes note; the controller is read by update(), in the caller's task.
+     */
+    template<class TController>
+    class TouchDriver
+    {
+    public:
+        static_assert(EWM_MAX_POINTERS <= 8U);
+
+        // intPin: the GPIO connected to the controller's interrupt line, or -1 if none
+        // is (in which case the controller is simply read every EWM_TOUCH_POLL_MSEC).
+        explicit TouchDriver(TController& controller, int8_t intPin = -1) noexcept
+            : _controller(controller), _intPin(intPin) { }
+
+        TouchDriver(const TouchDriver&) = delete;
+        TouchDriver& operator=(const TouchDriver&) = delete;
+
+        ~TouchDriver() { end(); }
+
+        // Call once the controller itself has been initialized.
+        void begin(const WindowManagerPtr& wm, const TouchTransform& transform)
+        {
+            EWM_ASSERT(wm);
+            _wm        = wm;
+            _transform = transform;
+            if (_intPin >= 0) {
+                pinMode(_intPin, INPUT_PULLUP);
+                attachInterruptArg(_intPin, &TouchDriver::_onInterrupt, this, FALLING);
+            }
+            // Whatever the controller has to say right now is worth hearing.
+            _signaled.store(true, std::memory_order_release);
+            EWM_LOG_D("touch driver started (interrupt: %hhd)", _intPin);
+        }
+
+        void end()
+        {
+            if (_wm && _intPin >= 0) {
+                detachInterrupt(_intPin);
+            }
+            _wm.reset();
+        }
+
+        // Call as often as is convenient (e.g. every time around loop(), before render());
+        // it returns right away unless there's reason to read the controller.
+        void update()
+        {
+            if (!_wm) {
+                return;
+            }
+            const uint32_t now = millis();
+            const bool signaled = _signaled.exchange(false, std::memory_order_acq_rel);
+            const bool due = (_intPin < 0 || _down != 0U) &&
+                now - _lastReadMsec >= EWM_TOUCH_POLL_MSEC;
+            if (!signaled && !due) {
+                return;
+            }
+            _lastReadMsec = now;
+            const auto count = min<uint8_t>(static_cast<uint8_t>(_controller.touched()),
+                EWM_MAX_POINTERS);
+            for (uint8_t pointer = 0U; pointer < EWM_MAX_POINTERS; pointer++) {
+                const auto bit = static_cast<uint8_t>(1U << pointer);
+                const bool down = pointer < count;
+                if (down) {
+                    const auto raw = _controller.getPoint(pointer);
+                    _points[pointer] = _transform.apply(raw.x, raw.y);
+                } else if ((_down & bit) == 0U) {
+                    continue;
+                }
+                // Should there be no room for it, the release in particular is retried
+                // next time around.
+                if (_wm->postTouch(_points[pointer].x, _points[pointer].y, down, pointer)) {
+                    _down = down ? (_down | bit) : (_down & ~bit);
+                }
+            }
+        }
+
+    private:
+        static void IRAM_ATTR _onInterrupt(void* arg)
+        {
+            static_cast<TouchDriver*>(arg)->_signaled.store(true, std::memory_order_release);
+        }
+
+        TController& _controller;
+        WindowManagerPtr _wm;
+        TouchTransform _transform;
+        std::array<Point, EWM_MAX_POINTERS> _points;
+        std::atomic<bool> _signaled { false };
+        uint32_t _lastReadMsec = 0U;
+        uint8_t _down          = 0U; /**< Bit per pointer, as last posted. */
+        int8_t _intPin         = -1;
+    };
+# endif
 } // namespace exostra
 
 #endif // !_EXOSTRA_H_INCLUDED
@@ -43,6 +43,9 @@
 # define DISPLAY_WIDTH 720
 # define DISPLAY_HEIGHT 720
 # define TFT_ROTATION 0
+# define TOUCH_WIDTH DISPLAY_WIDTH
+# define TOUCH_HEIGHT DISPLAY_HEIGHT
+# define TOUCH_MAPPING TouchMapping::None
 # define I2C_TOUCH_ADDR 0x48
 //# define EWM_GFX_ADAFRUIT
 # define EWM_GFX_ARDUINO
@@ -52,6 +55,9 @@
 # define DISPLAY_WIDTH 480
 # define DISPLAY_HEIGHT 480
 # define TFT_ROTATION 0
+# define TOUCH_WIDTH DISPLAY_WIDTH
+# define TOUCH_HEIGHT DISPLAY_HEIGHT
+# define TOUCH_MAPPING TouchMapping::None
 # define I2C_TOUCH_ADDR 0x15
 //# define EWM_GFX_ADAFRUIT
 # define EWM_GFX_ARDUINO
@@ -61,10 +67,9 @@
 # define DISPLAY_WIDTH 240
 # define DISPLAY_HEIGHT 320
 # define TFT_ROTATION 3
-# define TS_MINX 0
-# define TS_MINY 0
-# define TS_MAXX DISPLAY_WIDTH
-# define TS_MAXY DISPLAY_HEIGHT
+# define TOUCH_WIDTH DISPLAY_WIDTH
+# define TOUCH_HEIGHT DISPLAY_HEIGHT
+# define TOUCH_MAPPING TouchMapping::SwapXY | TouchMapping::MirrorY
 # define I2C_TOUCH_ADDR 0x38
 # define EWM_GFX_ADAFRUIT
 # define EYESPI_DISPLAY
@@ -77,10 +82,9 @@
 # define DISPLAY_WIDTH 320
 # define DISPLAY_HEIGHT 480
 # define TFT_ROTATION 3
-# define TS_MINX 0
-# define TS_MINY 0
-# define TS_MAXX DISPLAY_WIDTH
-# define TS_MAXY DISPLAY_HEIGHT
+# define TOUCH_WIDTH DISPLAY_WIDTH
+# define TOUCH_HEIGHT DISPLAY_HEIGHT
+# define TOUCH_MAPPING TouchMapping::SwapXY | TouchMapping::MirrorX
 # define I2C_TOUCH_ADDR 0x38
 # define EWM_GFX_ADAFRUIT
 # define EYESPI_DISPLAY
@@ -92,10 +96,9 @@
 # define DISPLAY_WIDTH 800
 # define DISPLAY_HEIGHT 480
 # define TFT_ROTATION 0
-# define TS_MINX 0
-# define TS_MINY 0
-# define TS_MAXX DISPLAY_WIDTH
-# define TS_MAXY DISPLAY_HEIGHT
+# define TOUCH_WIDTH 1024
+# define TOUCH_HEIGHT 1024
+# define TOUCH_MAPPING TouchMapping::None
 # define EWM_GFX_ADAFRUIT
 //# define EWM_GFX_ARDUINO
 # define EWM_ADAFRUIT_RA8875
@@ -104,10 +107,6 @@
 # error "invalid display selection"
 #endif
 
-#if DISPLAY_WIDTH != DISPLAY_HEIGHT
-# define COORDINATE_MAPPING
-#endif
-
 #define TFT_SCREENSAVER_AFTER 0.5 * 60 * 1000
 
 #include "exostra.h"
@@ -115,7 +114,7 @@ using namespace exostra;
 
 #if defined(TFT_480_RECTANGLE)
 Adafruit_FT5336 ctp;
-#else
+#elif !defined(EWM_ADAFRUIT_RA8875)
 Adafruit_FT6206 focal_ctp;
 Adafruit_CST8XX cst_ctp;
 #endif
@@ -153,6 +152,20 @@ UMS3 ums3;
 # endif
 #endif
 
+// The touch controller's interrupt line, if it's wired up.
+#if defined(PIN_INT)
+# define PIN_TOUCH_INT PIN_INT
+#else
+# define PIN_TOUCH_INT -1
+#endif
+
+#if defined(TFT_480_RECTANGLE)
+TouchDriver<Adafruit_FT5336> touch(ctp, PIN_TOUCH_INT);
+#elif !defined(EWM_ADAFRUIT_RA8875)
+TouchDriver<Adafruit_FT6206> focalTouch(focal_ctp, PIN_TOUCH_INT);
+TouchDriver<Adafruit_CST8XX> cstTouch(cst_ctp, PIN_TOUCH_INT);
+#endif
+
 #if defined(S3) || defined(ARDUINO_ADAFRUIT_FEATHER_ESP32S2_REVTFT)
 # if defined(EWM_GFX_ADAFRUIT)
 #  if defined(TFT_320_RECTANGLE)
@@ -248,6 +261,20 @@ public:
   using ProgressBar::ProgressBar;
   TestProgressBar() = default;
   virtual ~TestProgressBar() = default;
+
+  static constexpr TimerID StepTimer = 1;
+
+protected:
+  bool onTimer(MsgParam p1, MsgParam p2) override
+  {
+    if (p1 != StepTimer) {
+      return ProgressBar::onTimer(p1, p2);
+    }
+    const auto step = _getTheme()->getMetric(MetricID::ProgressMarqueeStep).getFloat();
+    const auto value = getProgressValue();
+    setProgressValue(value < 100.0f ? min(100.0f, value + step) : 0.0f);
+    return true;
+  }
 };
 
 class TestCheckbox : public CheckBox
@@ -297,6 +324,7 @@ std::shared_ptr<TestProgressBar> testProgressBar;
 std::shared_ptr<TestOKPrompt> okPrompt;
 
 bool isFocalTouch = false;
+TouchTransform touchTransform;
 
 void setup(void)
 {
@@ -344,6 +372,8 @@ void setup(void)
   display->PWM1config(true, RA8875_PWM_CLK_DIV1024);
   display->PWM1out(255);
   display->touchEnable(true);
+  touchTransform = TouchTransform(TOUCH_WIDTH, TOUCH_HEIGHT, wm->getDisplayWidth(),
+    wm->getDisplayHeight(), TOUCH_MAPPING);
 #else
 # if !defined(EYESPI_DISPLAY)
   expander->pinMode(PCA_TFT_BACKLIGHT, OUTPUT);
@@ -375,6 +405,17 @@ void setup(void)
   if (!touchInitialized) {
     on_fatal_error();
   }
+  touchTransform = TouchTransform(TOUCH_WIDTH, TOUCH_HEIGHT, wm->getDisplayWidth(),
+    wm->getDisplayHeight(), TOUCH_MAPPING);
+# if defined(TFT_480_RECTANGLE)
+  touch.begin(wm, touchTransform);
+# else
+  if (isFocalTouch) {
+    focalTouch.begin(wm, touchTransform);
+  } else {
+    cstTouch.begin(wm, touchTransform);
+  }
+# endif
 #endif
 
   WindowID id     = 1;
@@ -435,6 +476,7 @@ void setup(void)
   if (!testProgressBar) {
     on_fatal_error();
   }
+  testProgressBar->setTimer(TestProgressBar::StepTimer, 500U);
 
   auto testCheckbox = wm->createWindow<TestCheckbox>(
     defaultWin,
@@ -487,95 +529,28 @@ void setup(void)
   EWM_LOG_I("setup completed");
 }
 
-#if defined(COORDINATE_MAPPING)
-# if TFT_ROTATION != 3 && TFT_ROTATION != 0
-#  error "only rotation orientations 3 and 0 are implemented"
-# endif
-long mapXCoord(Coord x) noexcept
-{
-# if TFT_ROTATION == 0
-  return x;
-# elif TFT_ROTATION == 3
-  return map(x, TS_MINX, TS_MAXX, TS_MAXX, TS_MINX);
-# endif
-}
-long mapYCoord(Coord y) noexcept
-{
-# if TFT_ROTATION == 0
-  return y;
-# elif TFT_ROTATION == 3
-  return map(y, TS_MINY, TS_MAXY, TS_MAXY, TS_MINY);
-# endif
-}
-std::pair<Coord, Coord> swapCoords(Coord x, Coord y)
-{
-# if TFT_ROTATION == 3
-  auto tmp = y;
-  y = x;
-  x = wm->getDisplayWidth() - tmp;
-# endif
-  return std::make_pair(x, y);
-}
-#endif
-
-float curProgress = 0.0f;
-float progressStep = wm->getTheme()->getMetric(MetricID::ProgressMarqueeStep).getFloat();
-uint32_t lastProgress = 0U;
-
 void loop()
 {
 #if defined(EWM_ADAFRUIT_RA8875)
-  static constexpr float xScale = 1024.0f / DISPLAY_WIDTH;
-  static constexpr float yScale = 1024.0f / DISPLAY_HEIGHT;
-  if (!digitalRead(PIN_INT)) {
-    if (display->touched()) {
-      uint16_t x, y;
-      if (display->touchRead(&x, &y)) {
-        wm->hitTest(static_cast<Coord>(x / xScale), static_cast<Coord>(y / yScale));
-      }
+  // The RA8875's resistive touch screen is read through the display itself.
+  static Point pt;
+  bool touching = false;
+  if (!digitalRead(PIN_INT) && display->touched()) {
+    uint16_t x, y;
+    touching = true;
+    if (display->touchRead(&x, &y)) {
+      pt = touchTransform.apply(x, y);
     }
   }
+  wm->postTouch(pt.x, pt.y, touching);
+#elif defined(TFT_480_RECTANGLE)
+  touch.update();
 #else
-# if !defined(TFT_480_RECTANGLE)
-  if (isFocalTouch && focal_ctp.touched()) {
-    TS_Point pt = focal_ctp.getPoint();
-#  if defined(COORDINATE_MAPPING)
-    const auto tmp = swapCoords(mapXCoord(pt.x), mapYCoord(pt.y));
-    pt.x = tmp.first;
-    pt.y = tmp.second;
-#  endif
-    wm->hitTest(pt.x, pt.y);
-  } else if (!isFocalTouch && cst_ctp.touched()) {
-    CST_TS_Point pt = cst_ctp.getPoint();
-#  if defined(COORDINATE_MAPPING)
-    const auto tmp = swapCoords(mapXCoord(pt.x), mapYCoord(pt.y));
-    pt.x = tmp.first;
-    pt.y = tmp.second;
-#  endif
-    wm->hitTest(pt.x, pt.y);
-  }
-# elif defined(TFT_480_RECTANGLE)
-  if (ctp.touched() > 0) {
-    FT_TS_Point pt = ctp.getPoint();
-    auto tmp = pt.y;
-#  if defined(COORDINATE_MAPPING)
-    pt.y = mapXCoord(wm->getDisplayHeight() - pt.x);
-    pt.x = mapYCoord(tmp);
-#  endif
-    if (pt.x >= 0 && pt.y >= 0) {
-      wm->hitTest(pt.x, pt.y);
-    }
+  if (isFocalTouch) {
+    focalTouch.update();
+  } else {
+    cstTouch.update();
   }
-# endif
 #endif
-  if (millis() - lastProgress > 500U) {
-    lastProgress = millis();
-    if (curProgress < 100.0f) {
-      curProgress += progressStep;
-    } else {
-      curProgress = 0.0f;
-    }
-    testProgressBar->setProgressValue(curProgress);
-  }
   wm->render();
 }